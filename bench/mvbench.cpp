@@ -0,0 +1,1258 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <malloc.h>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+#include <wythe/aggregate.h>
+#include <wythe/concurrent_children.h>
+#include <wythe/journal.h>
+#include <wythe/json.h>
+#include <wythe/lazy_multivector.h>
+#include <wythe/multivector.h>
+#include <wythe/multivector_view.h>
+#include <wythe/parallel_builder.h>
+#include <wythe/parallel_serialize.h>
+#include <wythe/partitioned.h>
+#include <wythe/selector.h>
+#include <wythe/serialize.h>
+#include <wythe/shared_multivector.h>
+#include <wythe/string_multivector.h>
+#include <wythe/text_stream.h>
+#include <wythe/traversal.h>
+#include <wythe/tree_labels.h>
+#include <wythe/value_index.h>
+#include "command.h"
+#include "unit.h"
+
+// number of nodes in the generated trees, set with --nodes
+static size_t nodes = 1000000;
+
+// heap bytes in use and the high water mark, for peak memory.  Atomic since
+// the concurrent benchmarks allocate from many threads; relaxed since they
+// are only read after the threads are joined.
+static std::atomic<size_t> heap_bytes(0), heap_peak(0);
+
+void *operator new(size_t n) {
+    void *p = malloc(n);
+    if (!p)
+        throw std::bad_alloc();
+    auto size = malloc_usable_size(p);
+    auto now = heap_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    auto peak = heap_peak.load(std::memory_order_relaxed);
+    while (now > peak && !heap_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+        ;
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    if (p)
+        heap_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+// run f and return the elapsed time
+template <typename F> wythe::timer time_it(F f) {
+    wythe::timer t;
+    t.start();
+    f();
+    t.stop();
+    return t;
+}
+
+// build a tree of roughly n nodes with the given fan out, values made by make(i)
+template <typename T, typename Make>
+wythe::multivector<T> make_tree(size_t n, size_t fan_out, Make make) {
+    wythe::multivector<T> tree;
+    std::vector<typename wythe::multivector<T>::cursor> level{tree.root()};
+    size_t i = 0;
+    while (i < n) {
+        std::vector<typename wythe::multivector<T>::cursor> next;
+        for (auto p : level) {
+            p.reserve(fan_out);
+            for (size_t k = 0; k < fan_out && i < n; ++k, ++i)
+                p.emplace_back(make(i));
+            for (auto c = p.begin(); c != p.end(); ++c) next.push_back(c);
+        }
+        level.swap(next);
+    }
+    return tree;
+}
+
+// a heavy value type that counts its special member calls
+struct heavy {
+    static size_t defaults, copies, assigns;
+    heavy() { ++defaults; }
+    explicit heavy(size_t n) : name(48, char('a' + n % 26)), n(n) {}
+    heavy(const heavy &b) : name(b.name), n(b.n) { ++copies; }
+    heavy(heavy &&b) noexcept : name(std::move(b.name)), n(b.n) {}
+    heavy &operator=(const heavy &b) {
+        name = b.name;
+        n = b.n;
+        ++assigns;
+        return *this;
+    }
+    std::string name;
+    size_t n = 0;
+};
+
+size_t heavy::defaults = 0;
+size_t heavy::copies = 0;
+size_t heavy::assigns = 0;
+
+static void report_counts(const char *what, size_t n) {
+    std::cout << "  " << what << ": " << double(heavy::defaults) / n
+              << " default constructions, " << double(heavy::copies) / n
+              << " copies, " << double(heavy::assigns) / n
+              << " assignments per node\n";
+    heavy::defaults = heavy::copies = heavy::assigns = 0;
+}
+
+// the pre in-place copy: default construct each value and then assign it
+template <typename Cursor, typename ConstCursor>
+void default_then_assign(Cursor parent, ConstCursor from) {
+    parent.reserve(from.size());
+    for (auto i = from.begin(); i != from.end(); ++i) {
+        auto c = parent.emplace();
+        *c = *i;
+        default_then_assign(c, i);
+    }
+}
+
+void copying() {
+    std::cout << "copy " << nodes << " heavy nodes:\n";
+    auto tree = make_tree<heavy>(nodes, 8, [](size_t i) { return heavy(i); });
+    heavy::defaults = heavy::copies = heavy::assigns = 0;
+
+    std::unique_ptr<wythe::multivector<heavy>> copy;
+    auto t = time_it([&] { copy.reset(new wythe::multivector<heavy>(tree)); });
+    std::cout << "  copy constructed in place: " << t << '\n';
+    report_counts("in place", nodes + 1);
+
+    wythe::multivector<heavy> old;
+    t = time_it([&] { default_then_assign(old.root(), tree.root()); });
+    std::cout << "  default construct then assign: " << t << '\n';
+    report_counts("default then assign", nodes);
+}
+
+// bytes held by the subvectors of a tree, plus value_bytes(value) for each value
+template <typename Cursor, typename ValueBytes>
+size_t tree_bytes(Cursor parent, ValueBytes value_bytes) {
+    size_t n = parent.item_ref().nodes_.capacity() * sizeof(parent.item_ref());
+    for (auto i = parent.begin(); i != parent.end(); ++i)
+        n += value_bytes(*i) + tree_bytes(i, value_bytes);
+    return n;
+}
+
+// an XML-like document: repeating tag names with a few unique text leaves
+static std::string xml_token(size_t i) {
+    static const char *tags[] = {
+        "record", "name", "description", "timestamp_utc", "crc", "length",
+        "value", "message_header", "source_address", "destination_address",
+        "payload", "sequence_number", "field", "enumeration", "item", "units"};
+    if (i % 5 == 4)
+        return "v" + std::to_string(i); // unique text, fits in SSO
+    return tags[(i * 7) % (sizeof(tags) / sizeof(tags[0]))];
+}
+
+void interning() {
+    std::cout << "intern " << nodes << " XML-like string nodes:\n";
+    wythe::multivector<std::string> plain;
+    auto t = time_it([&] {
+        plain = make_tree<std::string>(nodes, 6, xml_token);
+    });
+    std::cout << "  build multivector<std::string>: " << t << '\n';
+
+    wythe::string_multivector interned;
+    t = time_it([&] {
+        interned = make_tree<wythe::interned_string>(
+            nodes, 6, [](size_t i) { return wythe::interned_string(xml_token(i)); });
+    });
+    std::cout << "  build string_multivector: " << t << '\n';
+
+    auto plain_bytes = tree_bytes(plain.root(), [](const std::string &s) {
+        return s.capacity() > sizeof(std::string) - 1 ? s.capacity() + 1 : 0;
+    });
+    auto interned_bytes = tree_bytes(interned.root(), [](wythe::interned_string) { return 0; });
+    auto pool_bytes = wythe::string_pool::instance().bytes();
+    std::cout << "  multivector<std::string> memory: " << plain_bytes / 1024 << " KiB\n";
+    std::cout << "  string_multivector memory: " << interned_bytes / 1024 << " KiB + "
+              << pool_bytes / 1024 << " KiB pool ("
+              << wythe::string_pool::instance().size() << " unique strings)\n";
+    std::cout << "  saved: "
+              << 100.0 * (1.0 - double(interned_bytes + pool_bytes) / plain_bytes) << "%\n";
+
+    t = time_it([&] { auto copy = plain; });
+    std::cout << "  copy multivector<std::string>: " << t << '\n';
+    t = time_it([&] { auto copy = interned; });
+    std::cout << "  copy string_multivector: " << t << '\n';
+
+    auto plain_copy = plain;
+    auto interned_copy = interned;
+    bool eq = false;
+    t = time_it([&] { eq = plain == plain_copy; });
+    std::cout << "  compare multivector<std::string>: " << t << (eq ? "" : " (unequal)") << '\n';
+    t = time_it([&] { eq = interned == interned_copy; });
+    std::cout << "  compare string_multivector: " << t << (eq ? "" : " (unequal)") << '\n';
+}
+
+// a tree built one emplace_back at a time, as parsers do
+static wythe::multivector<int> grown_tree(size_t n) {
+    wythe::multivector<int> tree;
+    std::vector<wythe::multivector<int>::cursor> stack{tree.root()};
+    uint64_t r = 12345;
+    for (size_t i = 0; i < n; ++i) {
+        r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto c = stack.back().emplace(int(i));
+        switch ((r >> 33) % 8) {
+        case 0: stack.push_back(c); break;
+        case 1:
+            if (stack.size() > 1) stack.pop_back();
+            break;
+        default: break;
+        }
+    }
+    return tree;
+}
+
+void compacting() {
+    std::cout << "compact a grown tree of " << nodes << " nodes:\n";
+    auto tree = grown_tree(nodes);
+    auto bytes = [](wythe::multivector<int> &t) { return tree_bytes(t.root(), [](int) { return 0; }); };
+    auto before = bytes(tree);
+    size_t sum = 0;
+    auto traverse = [&] {
+        for (auto i = tree.begin(); i != tree.end(); ++i)
+            wythe::recurse(i, [&](wythe::multivector<int>::cursor c) { sum += *c; });
+    };
+    auto t = time_it(traverse);
+    std::cout << "  recurse before: " << t << '\n';
+
+    size_t reclaimed = 0;
+    t = time_it([&] { reclaimed = tree.compact(); });
+    std::cout << "  compact: " << t << ", reclaimed " << reclaimed / 1024 << " KiB of "
+              << before / 1024 << " KiB (" << 100.0 * reclaimed / before << "%)\n";
+    std::cout << "  memory after: " << bytes(tree) / 1024 << " KiB\n";
+    t = time_it(traverse);
+    std::cout << "  recurse after: " << t << (sum ? "" : " ") << '\n';
+}
+
+static std::string gbs(size_t bytes, const wythe::timer &t) {
+    std::ostringstream os;
+    os << double(bytes) / (t.nano() > 0 ? t.nano() : 1) << " GB/s";
+    return os.str();
+}
+
+template <typename T> void binary_round_trip(const char *what, const wythe::multivector<T> &tree) {
+    std::string s;
+    s.reserve(1024);
+    auto t = time_it([&] { wythe::serialize(tree, wythe::string_sink(s)); });
+    std::cout << "  serialize " << what << ": " << t << ", " << s.size() / 1024 << " KiB, "
+              << gbs(s.size(), t) << '\n';
+    std::string again;
+    again.reserve(s.size());
+    t = time_it([&] { wythe::serialize(tree, wythe::string_sink(again)); });
+    std::cout << "  serialize " << what << " into a reserved buffer: " << t << ", "
+              << gbs(again.size(), t) << '\n';
+
+    wythe::multivector<T> back;
+    t = time_it([&] { back = wythe::deserialize<T>(wythe::memory_source(s)); });
+    std::cout << "  deserialize " << what << ": " << t << ", " << gbs(s.size(), t)
+              << (back == tree ? "" : " (mismatch!)") << '\n';
+}
+
+void binary() {
+    std::cout << "binary serialization of " << nodes << " nodes:\n";
+    binary_round_trip("int", make_tree<int>(nodes, 8, [](size_t i) { return int(i); }));
+    binary_round_trip("std::string", make_tree<std::string>(nodes, 8, xml_token));
+}
+
+void viewing() {
+    std::cout << "memory mapped view of " << nodes << " nodes:\n";
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    std::string binary_name = "mvbench.mvb", view_name = "mvbench.mvv";
+    {
+        std::ofstream b(binary_name, std::ios::binary), v(view_name, std::ios::binary);
+        wythe::serialize(tree, wythe::ostream_sink(b));
+        wythe::write_view(tree, wythe::ostream_sink(v));
+    }
+
+    wythe::multivector<int> loaded;
+    auto t = time_it([&] {
+        std::ifstream f(binary_name, std::ios::binary);
+        loaded = wythe::deserialize<int>(wythe::istream_source(f));
+    });
+    std::cout << "  deserialize from file: " << t << '\n';
+
+    wythe::multivector_view<int> view;
+    t = time_it([&] { view = wythe::multivector_view<int>::open(view_name); });
+    std::cout << "  open view: " << t << '\n';
+
+    long sum = 0;
+    t = time_it([&] {
+        for (auto i = wythe::to_linear(view.begin()); i != wythe::to_linear(view.end()); ++i)
+            sum += *i;
+    });
+    std::cout << "  linear traversal of view: " << t << '\n';
+    t = time_it([&] {
+        for (auto i = wythe::to_linear(loaded.cbegin()); i != wythe::to_linear(loaded.cend()); ++i)
+            sum -= *i;
+    });
+    std::cout << "  linear traversal of multivector: " << t << (sum ? " (mismatch!)" : "") << '\n';
+    std::remove(binary_name.c_str());
+    std::remove(view_name.c_str());
+}
+
+void lazy_loading() {
+    std::cout << "lazy loading of " << nodes << " nodes:\n";
+    std::string name = "mvbench.mvv";
+    {
+        auto tree = make_tree<std::string>(nodes, 8, xml_token);
+        std::ofstream v(name, std::ios::binary);
+        wythe::write_view(tree, wythe::ostream_sink(v));
+    }
+
+    auto base = heap_bytes.load();
+    wythe::multivector<std::string> loaded;
+    auto t = time_it([&] {
+        auto view = wythe::multivector_view<std::string>::open(name);
+        wythe::append(loaded.root(), view.root());
+    });
+    std::cout << "  load everything: " << t << ", " << (heap_bytes - base) / 1024 << " KiB\n";
+
+    auto lazy = wythe::lazy_multivector<std::string>::open(name, 256);
+    size_t length = 0;
+    t = time_it([&] {
+        for (size_t i = 0; i < 1000; ++i) {
+            auto c = lazy.begin() + i % 8;
+            while (!c.empty()) c = c.begin() + (i * 7919) % c.size();
+            length += (*c).size();
+        }
+    });
+    std::cout << "  lazy, 1000 root to leaf paths: " << t << ", " << lazy.loads() << " loads, "
+              << lazy.resident() << " resident\n";
+    std::string all;
+    t = time_it([&] { all = wythe::compact_string(lazy); });
+    std::cout << "  lazy, compact_string of everything: " << t << ", " << lazy.loads()
+              << " loads, " << lazy.resident() << " resident"
+              << (length && all == wythe::compact_string(loaded) ? "" : " (mismatch!)") << '\n';
+    std::remove(name.c_str());
+}
+
+// the child indices from the root to c, scanning siblings as parent() used to
+template <typename Cursor> std::vector<size_t> scanning_path_of(Cursor c) {
+    std::vector<size_t> path;
+    while (!c.is_root()) {
+        auto first = c.item_ptr();
+        while (!first->is_first_child()) --first;
+        path.push_back(c.item_ptr() - first);
+        auto parent = first->parent;
+        c = typename Cursor::cursor_type(nullptr, parent);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void paths() {
+    std::cout << "resolve paths in " << nodes << " nodes:\n";
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    std::vector<std::vector<size_t>> fixed;
+    std::vector<wythe::multivector<int>::cursor> leaves;
+    for (size_t i = 0; i < 1000; ++i) {
+        auto c = tree.root();
+        std::vector<size_t> p;
+        for (size_t k = i * 7919; !c.empty(); k /= 3) {
+            p.push_back(k % c.size());
+            c = c.begin() + p.back();
+        }
+        fixed.push_back(p);
+        leaves.push_back(c);
+    }
+
+    const int rounds = 1000;
+    long sum = 0;
+    auto t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &p : fixed)
+                sum += *wythe::at_path(tree.root(), std::span<const size_t>(p));
+    });
+    std::cout << "  at_path: " << t.nano() / (rounds * fixed.size()) << " ns per path\n";
+    wythe::path_cache<int> cache(tree, 16384);
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &p : fixed)
+                sum -= *cache.at(p);
+    });
+    std::cout << "  path_cache: " << t.nano() / (rounds * fixed.size()) << " ns per path, "
+              << cache.hits() * 100 / (cache.hits() + cache.misses()) << "% hits"
+              << (sum ? " (mismatch!)" : "") << '\n';
+
+    size_t depth = 0;
+    t = time_it([&] {
+        for (int r = 0; r < 100; ++r)
+            for (auto c : leaves) depth += wythe::path_of(c).size();
+    });
+    std::cout << "  path_of: " << t.nano() / (100 * leaves.size()) << " ns per path\n";
+    t = time_it([&] {
+        for (int r = 0; r < 100; ++r)
+            for (auto c : leaves) depth -= scanning_path_of(c).size();
+    });
+    std::cout << "  path by scanning siblings: " << t.nano() / (100 * leaves.size())
+              << " ns per path" << (depth ? " (mismatch!)" : "") << '\n';
+
+    size_t roots = 0;
+    t = time_it([&] {
+        for (int r = 0; r < 100; ++r)
+            for (auto c : leaves) roots += wythe::get_root(c).size();
+    });
+    std::cout << "  get_root: " << t.nano() / (100 * leaves.size()) << " ns\n";
+    t = time_it([&] {
+        for (int r = 0; r < 100; ++r)
+            for (auto c : leaves) {
+                auto p = wythe::to_precursor(c);
+                roots -= wythe::get_root(wythe::multivector<int>::cursor(p)).size();
+            }
+    });
+    std::cout << "  get_root by parent(): " << t.nano() / (100 * leaves.size()) << " ns"
+              << (roots ? " (mismatch!)" : "") << '\n';
+}
+
+struct named {
+    std::string name;
+    int value;
+    bool operator==(const std::string &n) const { return name == n; }
+};
+
+static wythe::multivector<named> named_tree(size_t n) {
+    return make_tree<named>(n, 8, [](size_t i) { return named{"n" + std::to_string(i), int(i)}; });
+}
+
+void indexing() {
+    std::cout << "look up " << nodes << " named records:\n";
+    auto by_name = [](const named &x) -> const std::string & { return x.name; };
+    typedef wythe::value_index<named, decltype(by_name)> index_type;
+    auto tree = named_tree(nodes);
+    std::vector<std::string> wanted;
+    for (size_t i = 0; i < 1000; ++i)
+        wanted.push_back("n" + std::to_string(i * 7919 % nodes));
+
+    long sum = 0;
+    const size_t scans = 20;
+    auto t = time_it([&] {
+        for (size_t i = 0; i < scans; ++i) {
+            wythe::multivector<named>::linear_cursor c = tree.begin(), last = tree.end();
+            while (c != last && c->name != wanted[i])
+                ++c;
+            sum += c->value;
+        }
+    });
+    for (size_t i = 0; i < scans; ++i)
+        sum -= std::stoi(wanted[i].substr(1));
+    std::cout << "  scan: " << long(t.nano() / scans) << " ns per lookup\n";
+
+    heap_bytes = heap_peak = 0;
+    std::unique_ptr<index_type> index;
+    t = time_it([&] { index.reset(new index_type(tree, by_name)); });
+    std::cout << "  build the index: " << t << ", " << heap_bytes / tree.size()
+              << " bytes per item\n";
+    const int rounds = 100;
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &w : wanted)
+                sum += index->find(w)->value;
+    });
+    for (auto &w : wanted)
+        sum -= rounds * std::stol(w.substr(1));
+    std::cout << "  value_index: " << t.nano() / (rounds * wanted.size()) << " ns per lookup"
+              << (sum ? " (mismatch!)" : "") << '\n';
+    index.reset();
+
+    // the cost of keeping the index up to date
+    auto mutate = [](wythe::multivector<named> &tree) {
+        for (size_t i = 0; i < nodes; ++i) {
+            auto p = tree.begin() + i % 8;
+            p.emplace_back(named{"m" + std::to_string(i), int(i)});
+            if (i % 4 == 3)
+                p.pop_back();
+            else if (i % 8 == 5)
+                (p.end() - 1).assign(named{"a" + std::to_string(i), int(i)});
+        }
+    };
+    {
+        auto a = named_tree(8);
+        t = time_it([&] { mutate(a); });
+        std::cout << "  " << nodes << " mutations: " << t << '\n';
+    }
+    {
+        auto a = named_tree(8);
+        index_type i(a, by_name);
+        t = time_it([&] { mutate(a); });
+        std::cout << "  indexed: " << t << (i.size() == a.size() ? "" : " (mismatch!)") << '\n';
+    }
+}
+
+void ancestry() {
+    typedef wythe::multivector<int>::cursor cursor;
+    std::cout << "ancestor tests in " << nodes << " nodes:\n";
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    std::vector<cursor> all;
+    wythe::recurse(tree.root(), [&](cursor c) { all.push_back(c); });
+    std::vector<std::pair<cursor, cursor>> pairs;
+    for (size_t i = 0; i < 10000; ++i)
+        pairs.emplace_back(all[i * 7919 % all.size()], all[i * 104729 % all.size()]);
+    auto climbing = [](cursor a, cursor b) {
+        for (;; b = b.parent()) {
+            if (a == b) return true;
+            if (b.is_root()) return false;
+        }
+    };
+
+    heap_bytes = heap_peak = 0;
+    wythe::tree_labels<int> labels(tree);
+    auto t = time_it([&] { labels.rebuild(); });
+    std::cout << "  label: " << t << ", " << heap_bytes / tree.size() << " bytes per item\n";
+
+    const int rounds = 100;
+    long n = 0;
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &p : pairs) n += climbing(p.first, p.second.parent());
+    });
+    std::cout << "  is_ancestor by parent(): " << t.nano() / (rounds * pairs.size()) << " ns\n";
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &p : pairs) n -= labels.is_ancestor(p.first, p.second.parent());
+    });
+    std::cout << "  is_ancestor by labels: " << t.nano() / (rounds * pairs.size()) << " ns"
+              << (n ? " (mismatch!)" : "") << '\n';
+
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &p : pairs) {
+                auto a = wythe::path_of(p.first), b = wythe::path_of(p.second);
+                auto m = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+                n += m.first - a.begin();
+            }
+    });
+    std::cout << "  lca by path_of: " << t.nano() / (rounds * pairs.size()) << " ns\n";
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &p : pairs) n -= labels.depth(labels.lca(p.first, p.second));
+    });
+    std::cout << "  lca by labels: " << t.nano() / (rounds * pairs.size()) << " ns"
+              << (n ? " (mismatch!)" : "") << '\n';
+}
+
+void selecting() {
+    typedef wythe::multivector<named>::cursor cursor;
+    static const char *words[] = {"record", "crc", "len", "data", "id", "name", "value", "flags"};
+    std::cout << "select from " << nodes << " named records:\n";
+    auto tree = make_tree<named>(nodes, 8, [](size_t i) {
+        return named{words[(i * 2654435761u >> 7) % 8], int(i)};
+    });
+
+    size_t n = 0;
+    auto t = time_it([&] {
+        wythe::recurse(tree.root(), [&](cursor c) {
+            if (c->name == "record")
+                for (auto k = c.begin(); k != c.end(); ++k)
+                    n += k->name == "crc";
+        });
+    });
+    std::cout << "  //record/crc by recurse: " << t << ", " << n << " matches\n";
+    wythe::selector<named> crcs("//record/crc");
+    t = time_it([&] {
+        for (auto c : crcs.select(tree.root()))
+            n -= c->name.size() == 3;
+    });
+    std::cout << "  //record/crc by selector: " << t << (n ? " (mismatch!)" : "") << '\n';
+
+    // a query that prunes: the big values below the records among the top three levels
+    auto big = [](const named &x) { return x.value > int(nodes) / 2; };
+    t = time_it([&] {
+        for (auto a = tree.begin(); a != tree.end(); ++a)
+            for (auto b = a.begin(); b != a.end(); ++b)
+                for (auto c = b.begin(); c != b.end(); ++c)
+                    if (c->name == "record")
+                        wythe::recurse(c, [&](cursor d) { n += big(*d); });
+    });
+    std::cout << "  /*/*/record//*[?big] by loops: " << t << ", " << n << " matches\n";
+    wythe::selector<named> deep("/*/*/record//*[?big]", {{"big", big}});
+    t = time_it([&] { n -= deep.select(tree.root()).count(); });
+    std::cout << "  /*/*/record//*[?big] by selector: " << t << (n ? " (mismatch!)" : "") << '\n';
+}
+
+void sorted_lookup() {
+    const size_t n = std::max<size_t>(nodes, 1);
+    std::cout << "look up keys among " << n << " sorted siblings:\n";
+    wythe::multivector<named> tree;
+    auto p = tree.root().emplace(named{"parent", 0});
+    p.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        char key[24];
+        snprintf(key, sizeof(key), "k%09zu", i);
+        p.emplace_back(named{key, int(i)});
+    }
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 1000; ++i) {
+        char key[24];
+        snprintf(key, sizeof(key), "k%09zu", i * 7919 % n);
+        keys.push_back(key);
+    }
+
+    long sum = 0;
+    const size_t scans = 20;
+    auto t = time_it([&] {
+        for (size_t i = 0; i < scans; ++i)
+            sum += std::find(p.begin(), p.end(), keys[i])->value;
+    });
+    std::cout << "  linear find: " << long(t.nano() / scans) << " ns per key\n";
+    for (size_t i = 0; i < scans; ++i)
+        sum -= wythe::find_child_sorted(p, keys[i], {}, &named::name)->value;
+    const int rounds = 100;
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto &k : keys)
+                sum += wythe::find_child_sorted(p, k, {}, &named::name)->value;
+    });
+    for (auto &k : keys)
+        sum -= rounds * std::stol(k.substr(1));
+    std::cout << "  find_child_sorted: " << t.nano() / (rounds * keys.size()) << " ns per key"
+              << (sum ? " (mismatch!)" : "") << '\n';
+}
+
+void aggregating() {
+    typedef wythe::multivector<named>::cursor cursor;
+    std::cout << "subtree aggregates of " << nodes << " records:\n";
+    auto tree = named_tree(nodes);
+    std::vector<cursor> all;
+    wythe::recurse(tree.root(), [&](cursor c) { all.push_back(c); });
+    std::vector<cursor> wanted;
+    for (size_t i = 0; i < 1000; ++i)
+        wanted.push_back(all[i * 7919 % std::min<size_t>(all.size(), 4681)]); // the top 5 levels
+
+    typedef wythe::sum_monoid<long, int named::*> sum_type;
+    heap_bytes = heap_peak = 0;
+    std::unique_ptr<wythe::subtree_aggregate<named, sum_type>> sum;
+    auto t = time_it([&] { sum.reset(new wythe::subtree_aggregate(tree, sum_type{&named::value})); });
+    std::cout << "  build: " << t << ", " << heap_bytes / tree.size() << " bytes per item\n";
+
+    long n = 0;
+    t = time_it([&] {
+        for (auto c : wanted) {
+            n += c->value;
+            wythe::recurse(c, [&](cursor d) { n += d->value; });
+        }
+    });
+    std::cout << "  sum by recurse: " << t.nano() / wanted.size() << " ns per query\n";
+    const int rounds = 1000;
+    t = time_it([&] {
+        for (int r = 0; r < rounds; ++r)
+            for (auto c : wanted) n -= sum->aggregate(c) * (r == 0);
+    });
+    std::cout << "  aggregate: " << t.nano() / (rounds * wanted.size()) << " ns per query"
+              << (n ? " (mismatch!)" : "") << '\n';
+    sum.reset();
+
+    // the cost of keeping aggregates up to date
+    auto mutate = [](wythe::multivector<named> &tree) {
+        for (size_t i = 0; i < nodes; ++i) {
+            auto p = (tree.begin() + i % 8).begin() + i / 8 % 8;
+            p.emplace_back(named{"m", int(i)});
+            if (i % 4 == 3)
+                p.pop_back();
+            else if (i % 8 == 5)
+                (p.end() - 1).assign(named{"a", int(i)});
+        }
+    };
+    auto time_mutations = [&](const char *what, auto make) {
+        auto a = named_tree(72);
+        [[maybe_unused]] auto agg = make(a); // observes a while it is timed
+        t = time_it([&] { mutate(a); });
+        std::cout << "  " << nodes << " mutations" << what << ": " << t << '\n';
+    };
+    time_mutations("", [](auto &) { return 0; });
+    time_mutations(" with a sum", [](auto &a) {
+        return std::make_unique<wythe::subtree_aggregate<named, sum_type>>(a, sum_type{&named::value});
+    });
+    typedef wythe::max_monoid<int, int named::*> max_type;
+    time_mutations(" with a max", [](auto &a) {
+        return std::make_unique<wythe::subtree_aggregate<named, max_type>>(a, max_type{&named::value});
+    });
+}
+
+// reads per second by n reader threads while one thread writes continuously
+template <typename Read, typename Write>
+static double reads_per_second(size_t n, Read read, Write write) {
+    std::atomic<bool> done{false};
+    std::atomic<size_t> reads{0};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n; ++i)
+        threads.emplace_back([&, i] {
+            size_t k = 0;
+            auto r = read(i);
+            while (!done.load(std::memory_order_relaxed)) {
+                r();
+                ++k;
+            }
+            reads += k;
+        });
+    std::thread writer([&] {
+        for (size_t i = 0; !done.load(std::memory_order_relaxed); ++i)
+            write(i);
+    });
+    wythe::timer t;
+    t.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    done = true;
+    t.stop();
+    for (auto &th : threads)
+        th.join();
+    writer.join();
+    return reads / (t.nano() / 1e9);
+}
+
+void sharing() {
+    std::cout << "readers of a tree of " << nodes << " nodes under continuous writes:\n";
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    // a reader sums the children of one item, a writer appends to and trims one
+    auto sum = [](wythe::multivector<int>::const_cursor c) {
+        long s = 0;
+        for (auto i = c.begin(); i != c.end(); ++i) s += *i;
+        return s;
+    };
+    auto edit = [](wythe::multivector<int> &t, size_t i) {
+        auto c = (t.begin() + i % 8).begin() + i / 8 % 8;
+        if (c.size() > 16)
+            c.pop_back();
+        else
+            c.emplace_back(int(i));
+    };
+
+    for (size_t n : {1, 2, 4, 8, 16, 32, 64}) {
+        std::shared_mutex lock;
+        auto locked = reads_per_second(
+            n,
+            [&](size_t i) {
+                return [&, i] {
+                    std::shared_lock<std::shared_mutex> g(lock);
+                    return sum((tree.begin() + i % 8).begin() + i / 8 % 8);
+                };
+            },
+            [&](size_t i) {
+                std::unique_lock<std::shared_mutex> g(lock);
+                edit(tree, i);
+            });
+
+        wythe::shared_multivector<int> shared(tree, 128);
+        auto snapshots = reads_per_second(
+            n,
+            [&](size_t i) {
+                return [&, i, r = std::make_shared<wythe::shared_multivector<int>::reader>(
+                                  shared.make_reader())] {
+                    auto s = r->read();
+                    return sum((s.tree().begin() + i % 8).begin() + i / 8 % 8);
+                };
+            },
+            [&](size_t i) {
+                shared.write([i, &edit](wythe::multivector<int> &t) { edit(t, i); });
+            });
+        std::cout << "  " << n << " readers: shared_mutex " << long(locked / 1000)
+                  << "k reads/s, shared_multivector " << long(snapshots / 1000) << "k reads/s, "
+                  << shared.copies() << " copies\n";
+    }
+}
+
+static std::string mbs(size_t bytes, const wythe::timer &t) {
+    std::ostringstream os;
+    os << double(bytes) * 1000.0 / (t.nano() > 0 ? t.nano() : 1) << " MB/s";
+    return os.str();
+}
+
+void parallel_binary() {
+    std::cout << "parallel serialize and deserialize of " << nodes << " nodes:\n";
+    auto tree = make_tree<std::string>(nodes, 8, xml_token);
+    std::string s;
+    auto t = time_it([&] { wythe::serialize(tree, wythe::string_sink(s)); });
+    std::cout << "  serialize: " << t << ", " << mbs(s.size(), t) << '\n';
+    wythe::multivector<std::string> loaded;
+    t = time_it([&] { loaded = wythe::deserialize<std::string>(wythe::memory_source(s)); });
+    std::cout << "  deserialize: " << t << ", " << mbs(s.size(), t) << '\n';
+
+    unsigned cores = std::thread::hardware_concurrency();
+    for (unsigned threads = 1; threads <= 16 && threads <= std::max(cores, 1u); threads *= 2) {
+        s.clear();
+        t = time_it([&] { wythe::parallel_serialize(tree, wythe::string_sink(s), threads); });
+        std::cout << "  parallel_serialize, " << threads << " threads: " << t << ", "
+                  << mbs(s.size(), t) << '\n';
+        t = time_it([&] { loaded = wythe::parallel_deserialize<std::string>(s, threads); });
+        std::cout << "  parallel_deserialize, " << threads << " threads: " << t << ", "
+                  << mbs(s.size(), t) << (loaded == tree ? "" : " (mismatch!)") << '\n';
+    }
+}
+
+// a typical hand-rolled recursive parser: tokens from an istream, emplace per value
+static void naive_parse(std::istream &is, wythe::multivector<int>::cursor parent) {
+    char ch;
+    while (is >> std::ws && is.get(ch)) {
+        if (ch == '}')
+            return;
+        if (ch == '{') {
+            naive_parse(is, --parent.end());
+            continue;
+        }
+        std::string token(1, ch);
+        while (is.peek() != EOF && !isspace(is.peek()) && is.peek() != '{' && is.peek() != '}')
+            token += char(is.get());
+        parent.emplace(std::stoi(token));
+    }
+}
+
+void parsing() {
+    std::cout << "parse compact_string of " << nodes << " nodes:\n";
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    auto s = wythe::compact_string(tree);
+
+    wythe::multivector<int> parsed;
+    auto t = time_it([&] { parsed = wythe::parse_compact<int>(s); });
+    std::cout << "  parse_compact: " << t << ", " << mbs(s.size(), t)
+              << (parsed == tree ? "" : " (mismatch!)") << '\n';
+
+    std::istringstream is(s);
+    t = time_it([&] { parsed = wythe::parse_compact<int>(is); });
+    std::cout << "  parse_compact from istream: " << t << ", " << mbs(s.size(), t) << '\n';
+
+    wythe::multivector<int> naive;
+    std::istringstream nis(s);
+    t = time_it([&] { naive_parse(nis, naive.root()); });
+    std::cout << "  recursive istream parser: " << t << ", " << mbs(s.size(), t)
+              << (naive == tree ? "" : " (mismatch!)") << '\n';
+}
+
+// the ostringstream, replace and normalize compact_string this replaced
+template <typename Cursor> std::string legacy_compact_string(Cursor parent) {
+    std::ostringstream ss;
+    wythe::recurse(parent,
+                   [&](Cursor self, int) {
+                       ss << *self;
+                       if (!self.empty())
+                           ss << " {";
+                       else {
+                           auto p = self.parent();
+                           if (self != --p.end())
+                               ss << ' ';
+                       }
+                   },
+                   [&](Cursor self, int) {
+                       if (!self.empty())
+                           ss << "} ";
+                   });
+    auto x = ss.str();
+    wythe::replace(x, " }", "}");
+    wythe::normalize(x);
+    return x;
+}
+
+template <typename Cursor> std::string legacy_to_text(Cursor parent) {
+    std::ostringstream ss;
+    wythe::recurse(parent, [&](Cursor self, int level) { ss << wythe::spaces(level * 2) << *self << '\n'; },
+                   [&](Cursor, int) {});
+    return ss.str();
+}
+
+template <typename T> void dump(const char *what, const wythe::multivector<T> &tree) {
+    std::string legacy, current;
+    auto t = time_it([&] { legacy = legacy_compact_string(tree.root()); });
+    std::cout << "  " << what << " ostringstream compact_string: " << t << ", " << mbs(legacy.size(), t) << '\n';
+    t = time_it([&] { current = wythe::compact_string(tree); });
+    std::cout << "  " << what << " compact_string: " << t << ", " << mbs(current.size(), t)
+              << (current == legacy ? "" : " (differs)") << '\n';
+    std::string buf;
+    buf.reserve(current.size());
+    t = time_it([&] { wythe::write_compact(tree.root(), buf); });
+    std::cout << "  " << what << " write_compact into a reused buffer: " << t << ", " << mbs(buf.size(), t) << '\n';
+
+    t = time_it([&] { legacy = legacy_to_text(tree.root()); });
+    std::cout << "  " << what << " ostringstream to_text: " << t << ", " << mbs(legacy.size(), t) << '\n';
+    t = time_it([&] { current = wythe::to_text(tree); });
+    std::cout << "  " << what << " to_text: " << t << ", " << mbs(current.size(), t)
+              << (current == legacy ? "" : " (differs)") << '\n';
+}
+
+void writing() {
+    std::cout << "write text of " << nodes << " nodes:\n";
+    dump("int", make_tree<int>(nodes, 8, [](size_t i) { return int(i); }));
+    dump("std::string", make_tree<std::string>(nodes, 8, xml_token));
+}
+
+void streaming() {
+    std::cout << "write text of " << nodes << " nodes to a file:\n";
+    auto tree = make_tree<std::string>(nodes, 8, xml_token);
+    std::string name = "mvbench.txt";
+    size_t peak = 0;
+    auto t = time_it([&] {
+        auto s = wythe::to_text(tree);
+        peak = s.capacity();
+        FILE *f = fopen(name.c_str(), "w");
+        fwrite(s.data(), 1, s.size(), f);
+        fclose(f);
+    });
+    std::cout << "  to_text then fwrite: " << t << ", " << peak / 1024 << " KiB string\n";
+    t = time_it([&] {
+        FILE *f = fopen(name.c_str(), "w");
+        wythe::stream_text(tree, wythe::file_sink(f));
+        fclose(f);
+    });
+    std::cout << "  stream_text to a FILE: " << t << ", 64 KiB buffer\n";
+    t = time_it([&] {
+        std::ofstream f(name);
+        wythe::stream_compact(tree, wythe::ostream_sink(f));
+    });
+    std::cout << "  stream_compact to an ofstream: " << t << ", 64 KiB buffer\n";
+    std::remove(name.c_str());
+}
+
+// json text for a tree: leaves are numbers, parents objects with an array of children
+template <typename Cursor> void write_json(Cursor parent, std::string &out) {
+    out += '[';
+    for (auto c = parent.begin(); c != parent.end(); ++c) {
+        if (c != parent.begin())
+            out += ',';
+        if (c.empty())
+            out += std::to_string(*c);
+        else {
+            out += "{\"id\":" + std::to_string(*c) + ",\"name\":\"n" + std::to_string(*c) +
+                   "\",\"children\":";
+            write_json(c, out);
+            out += '}';
+        }
+    }
+    out += ']';
+}
+
+// the usual alternative: a node-based document, copied into a multivector
+struct json_dom {
+    wythe::json_node node;
+    std::vector<json_dom> children;
+};
+
+struct json_dom_builder {
+    json_dom_builder() { stack.push_back(&root); }
+    void value(wythe::json_node &&n) { stack.back()->children.push_back({std::move(n), {}}); }
+    void start_children() { stack.push_back(&stack.back()->children.back()); }
+    void end_children() { stack.pop_back(); }
+    json_dom root;
+    std::vector<json_dom *> stack;
+};
+
+static void copy_dom(json_dom &d, wythe::multivector<wythe::json_node>::cursor parent) {
+    for (auto &c : d.children) {
+        auto i = parent.emplace(c.node);
+        copy_dom(c, i);
+    }
+}
+
+void json() {
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    std::string s;
+    write_json(tree.root(), s);
+    std::cout << "parse " << s.size() / 1024 << " KiB of JSON:\n";
+
+    wythe::multivector<wythe::json_node> built;
+    auto base = heap_bytes.load();
+    heap_peak = base;
+    auto t = time_it([&] { built = wythe::parse_json(s); });
+    auto size = heap_bytes - base;
+    std::cout << "  parse_json: " << t << ", " << mbs(s.size(), t) << ", tree " << size / 1024
+              << " KiB, peak " << (heap_peak - base) / 1024 << " KiB\n";
+
+    wythe::multivector<wythe::json_node> copied;
+    base = heap_bytes;
+    heap_peak = base;
+    t = time_it([&] {
+        json_dom_builder b;
+        wythe::json_parser<json_dom_builder> p(b);
+        p.feed(s);
+        p.finish();
+        copy_dom(b.root, copied.root());
+    });
+    std::cout << "  parse to a DOM then copy: " << t << ", " << mbs(s.size(), t) << ", peak "
+              << (heap_peak - base) / 1024 << " KiB" << (copied == built ? "" : " (mismatch!)")
+              << '\n';
+}
+
+void journaling() {
+    std::cout << "persist edits to a tree of " << nodes << " nodes:\n";
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    std::string name = "mvbench.journal";
+    auto t = time_it([&] {
+        FILE *f = fopen("mvbench.mvb", "wb");
+        wythe::serialize(tree, wythe::file_sink(f));
+        fclose(f);
+    });
+    std::cout << "  serialize the whole tree: " << t << '\n';
+    std::remove("mvbench.mvb");
+
+    const size_t edits = 10000;
+    {
+        wythe::mutation_journal<int> j(tree, name);
+        t = time_it([&] {
+            for (size_t i = 0; i < edits; ++i) {
+                auto p = ((tree.begin() + i % 8).begin() + i / 8 % 8).begin() + i / 64 % 8;
+                if (i % 2)
+                    (p.begin() + i / 512 % p.size()).assign(-int(i));
+                else
+                    p.emplace_back(int(i));
+            }
+            j.flush();
+        });
+        std::cout << "  journal " << edits << " edits: " << t << '\n';
+        t = time_it([&] { j.checkpoint(); });
+        std::cout << "  checkpoint: " << t << '\n';
+    }
+    wythe::multivector<int> replayed;
+    t = time_it([&] { replayed = wythe::replay<int>(name); });
+    std::cout << "  replay: " << t << (replayed == tree ? "" : " (mismatch!)") << '\n';
+    std::remove(name.c_str());
+    std::remove((name + ".checkpoint").c_str());
+}
+
+void partitioning() {
+    std::cout << "emplace into disjoint subtrees, " << nodes << " items in all:\n";
+    for (size_t n : {1, 2, 4, 8, 16, 32, 64}) {
+        auto run = [&](bool lock) {
+            wythe::multivector<int> tree;
+            for (size_t i = 0; i < n; ++i)
+                tree.emplace_back(int(i));
+            wythe::partitioned<int> parts(tree.root());
+            std::mutex global;
+            std::vector<std::thread> threads;
+            auto t = time_it([&] {
+                for (size_t i = 0; i < n; ++i)
+                    threads.emplace_back([&, i] {
+                        auto p = parts[i];
+                        for (size_t k = 0; k < nodes / n; ++k) {
+                            std::unique_lock<std::mutex> g(global, std::defer_lock);
+                            if (lock)
+                                g.lock();
+                            auto c = p.begin() + k % 64;
+                            if (p.size() < 64)
+                                c = p.emplace(int(k));
+                            c.emplace_back(int(k));
+                        }
+                    });
+                for (auto &th : threads)
+                    th.join();
+            });
+            return t;
+        };
+        auto locked = run(true);
+        auto free = run(false);
+        std::cout << "  " << n << " threads: one mutex " << nodes * 1000.0 / locked.nano()
+                  << "M items/s, partitioned " << nodes * 1000.0 / free.nano() << "M items/s\n";
+    }
+}
+
+void appending() {
+    const size_t parents = 4;
+    std::cout << "producers appending leaves under " << parents << " parents, " << nodes
+              << " items in all:\n";
+    for (size_t n : {1, 2, 4, 8, 16, 32, 64}) {
+        auto start = [&](auto produce) {
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < n; ++i)
+                threads.emplace_back([&, i] {
+                    for (size_t k = 0; k < nodes / n; ++k)
+                        produce((i + k) % parents, int(k));
+                });
+            for (auto &th : threads)
+                th.join();
+        };
+
+        wythe::multivector<int> a;
+        for (size_t i = 0; i < parents; ++i)
+            a.emplace_back(int(i));
+        std::mutex locks[parents];
+        auto locked = time_it([&] {
+            start([&](size_t p, int v) {
+                std::lock_guard<std::mutex> g(locks[p]);
+                (a.begin() + p).emplace_back(v);
+            });
+        });
+
+        wythe::multivector<int> b;
+        for (size_t i = 0; i < parents; ++i)
+            b.emplace_back(int(i));
+        wythe::concurrent_children<int> kids[parents];
+        auto free = time_it([&] { start([&](size_t p, int v) { kids[p].emplace_back(v); }); });
+        auto sealed = time_it([&] {
+            for (size_t i = 0; i < parents; ++i)
+                kids[i].seal(b.begin() + i);
+        });
+        std::cout << "  " << n << " producers: mutex per parent " << nodes * 1000.0 / locked.nano()
+                  << "M items/s, concurrent_children " << nodes * 1000.0 / free.nano()
+                  << "M items/s, seal " << sealed << (a.size() == b.size() ? "" : " (mismatch!)")
+                  << '\n';
+    }
+}
+
+void traversing() {
+    std::cout << "traverse a tree of " << nodes << " nodes:\n";
+    auto tree = make_tree<int>(nodes, 8, [](size_t i) { return int(i); });
+    typedef wythe::multivector<int>::const_cursor cursor;
+    const auto &c = tree;
+    long sum = 0, expected = 0;
+    auto report = [&](const char *what, const wythe::timer &t) {
+        std::cout << "  " << what << ": " << t << (sum == expected ? "" : " (mismatch!)") << '\n';
+        sum = 0;
+    };
+    auto t = time_it([&] { wythe::recurse(c.root(), [&](cursor i) { expected += *i; }); });
+    sum = expected;
+    report("recurse", t);
+    t = time_it([&] {
+        for (auto i = wythe::multivector<int>::const_linear_cursor(c.begin()); i != c.end(); ++i)
+            sum += *i;
+    });
+    report("linear_cursor", t);
+    t = time_it([&] {
+        for (auto i : wythe::preorder(c.root()))
+            sum += *i;
+    });
+    report("preorder", t);
+    t = time_it([&] {
+        for (auto i : wythe::postorder(c.root()))
+            sum += *i;
+    });
+    report("postorder", t);
+    t = time_it([&] {
+        for (auto v : wythe::with_depth(c.root()))
+            sum += *v.first;
+    });
+    report("with_depth", t);
+    t = time_it([&] {
+        for (auto i : wythe::leaves(c.root()))
+            sum += *i;
+    });
+    std::cout << "  leaves: " << t << '\n';
+    sum = 0;
+
+    // a reactor walking 1000 items per turn, resuming the same generator
+    size_t turns = 0;
+    t = time_it([&] {
+        auto g = wythe::preorder(c.root());
+        auto i = g.begin();
+        while (i != g.end()) {
+            for (size_t k = 0; k < 1000 && i != g.end(); ++k, ++i)
+                sum += **i;
+            ++turns;
+        }
+    });
+    std::cout << "  preorder in " << turns << " turns of 1000: " << t
+              << (sum == expected ? "" : " (mismatch!)") << '\n';
+}
+
+void building() {
+    const size_t jobs = 256, parents = 16;
+    std::cout << "build " << jobs << " fragments of std::string and attach them, " << nodes
+              << " items in all:\n";
+    auto fragment = [&](size_t k) {
+        return make_tree<std::string>(nodes / jobs, 8, [k](size_t i) { return xml_token(k + i); });
+    };
+    auto skeleton = [&] {
+        wythe::multivector<std::string> tree;
+        for (size_t p = 0; p < parents; ++p)
+            tree.emplace_back("part");
+        return tree;
+    };
+    auto rate = [&](const wythe::timer &t) { return nodes * 1000.0 / t.nano(); };
+
+    // the fragments built in turn and copied in with append
+    auto expected = skeleton();
+    auto t = time_it([&] {
+        for (size_t k = 0; k < jobs; ++k) {
+            auto f = fragment(k);
+            wythe::append(expected.begin() + k % parents, f.root());
+        }
+    });
+    std::cout << "  serial build and append: " << rate(t) << "M items/s\n";
+
+    for (unsigned threads : {1, 2, 4, 8, 16, 32, 64}) {
+        auto tree = skeleton();
+        t = time_it([&] {
+            wythe::parallel_builder<std::string> builder(tree);
+            for (size_t k = 0; k < jobs; ++k)
+                builder.add(tree.begin() + k % parents, [&, k](wythe::multivector<std::string> &f) { f = fragment(k); });
+            builder.run(threads);
+        });
+        std::cout << "  parallel_builder, " << threads << " threads: " << rate(t) << "M items/s"
+                  << (tree == expected ? "" : " (mismatch!)") << '\n';
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        wythe::command line("mvbench", "wythe::multivector benchmarks", "mvbench [options]");
+        line.add(wythe::option("nodes", 'n', "number of nodes in generated trees", "1000000",
+                               [](std::string v) { nodes = std::stoul(v); }));
+        line.add(wythe::option("copy", 'c', "copy construction of heavy values", [] { copying(); }));
+        line.add(wythe::option("intern", 'i', "interned strings on an XML-like tree", [] { interning(); }));
+        line.add(wythe::option("compact", 'C', "compact a tree grown with emplace_back", [] { compacting(); }));
+        line.add(wythe::option("binary", 'B', "binary serialize and deserialize", [] { binary(); }));
+        line.add(wythe::option("parallel", 'P', "parallel serialize and deserialize", [] { parallel_binary(); }));
+        line.add(wythe::option("view", 'V', "open and traverse a memory mapped view", [] { viewing(); }));
+        line.add(wythe::option("lazy", 'L', "load subvectors of a view file on demand", [] { lazy_loading(); }));
+        line.add(wythe::option("paths", 'N', "resolve index paths", [] { paths(); }));
+        line.add(wythe::option("index", 'I', "look up records by name", [] { indexing(); }));
+        line.add(wythe::option("ancestors", 'a', "ancestor tests and lowest common ancestors", [] { ancestry(); }));
+        line.add(wythe::option("select", 'S', "selector queries on named records", [] { selecting(); }));
+        line.add(wythe::option("sorted", 'k', "key lookup among sorted siblings", [] { sorted_lookup(); }));
+        line.add(wythe::option("aggregate", 'g', "subtree aggregates under mutation", [] { aggregating(); }));
+        line.add(wythe::option("readers", 'R', "snapshot readers under continuous writes", [] { sharing(); }));
+        line.add(wythe::option("partitions", 'T', "threads emplacing into disjoint subtrees", [] { partitioning(); }));
+        line.add(wythe::option("append", 'q', "producer threads appending children", [] { appending(); }));
+        line.add(wythe::option("traverse", 'G', "coroutine traversals against recurse and linear_cursor", [] { traversing(); }));
+        line.add(wythe::option("build", 'm', "build fragments on threads and graft them", [] { building(); }));
+        line.add(wythe::option("parse", 'p', "parse compact_string text", [] { parsing(); }));
+        line.add(wythe::option("write", 'w', "write compact_string and to_text", [] { writing(); }));
+        line.add(wythe::option("stream", 's', "stream text to a file", [] { streaming(); }));
+        line.add(wythe::option("json", 'j', "parse JSON into a tree", [] { json(); }));
+        line.add(wythe::option("journal", 'J', "journal edits to a large tree", [] { journaling(); }));
+        line.add(wythe::option("All", 'A', "run all", [] {
+            copying();
+            interning();
+            compacting();
+            binary();
+            parallel_binary();
+            viewing();
+            lazy_loading();
+            paths();
+            indexing();
+            ancestry();
+            selecting();
+            sorted_lookup();
+            aggregating();
+            sharing();
+            partitioning();
+            appending();
+            traversing();
+            building();
+            parsing();
+            writing();
+            streaming();
+            json();
+            journaling();
+        }));
+
+        line.parse(argc, argv);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,320 @@
+// mvsuite -- the main multivector operations on generated tree shapes, against a
+// node based tree, as JSON.
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <wythe/multivector.h>
+#include "command.h"
+#include "unit.h"
+
+// the largest tree, set with --nodes; sizes run in powers of 10 from 1000
+static size_t max_nodes = 1000000;
+// the operations on a tree of n nodes repeat until they have visited this many
+static size_t work = 1000000;
+// copying and comparing recurse, so the chain stops at this depth
+static const size_t max_chain = 10000;
+
+// A tree shape: item 0 is the root, items 1 to n the nodes, and the children
+// of item i are kids[first[i]] to kids[first[i + 1] - 1].
+struct shape {
+    std::string name;
+    size_t depth = 0;
+    std::vector<uint32_t> first, kids;
+};
+
+// the shape with the given parent of each node, parent[i] < i
+static shape make_shape(std::string name, const std::vector<uint32_t> &parent) {
+    shape s;
+    s.name = std::move(name);
+    auto n = parent.size();
+    s.first.assign(n + 2, 0);
+    for (size_t i = 1; i < n; ++i)
+        ++s.first[parent[i] + 2];
+    for (size_t i = 2; i < s.first.size(); ++i)
+        s.first[i] += s.first[i - 1];
+    s.kids.resize(n - 1);
+    for (size_t i = 1; i < n; ++i)
+        s.kids[s.first[parent[i] + 1]++] = uint32_t(i);
+    std::vector<size_t> depth(n, 0);
+    for (size_t i = 1; i < n; ++i)
+        s.depth = std::max(s.depth, depth[i] = depth[parent[i]] + 1);
+    return s;
+}
+
+static std::vector<shape> make_shapes(size_t n) {
+    std::vector<shape> shapes;
+    std::vector<uint32_t> parent(n + 1, 0);
+    if (n <= max_chain) {
+        for (size_t i = 1; i <= n; ++i)
+            parent[i] = uint32_t(i - 1);
+        shapes.push_back(make_shape("chain", parent));
+    }
+    for (size_t i = 1; i <= n; ++i)
+        parent[i] = 0;
+    shapes.push_back(make_shape("flat", parent));
+    for (size_t i = 1; i <= n; ++i)
+        parent[i] = uint32_t((i - 1) / 8);
+    shapes.push_back(make_shape("8-ary", parent));
+    std::mt19937 random(42);
+    for (size_t i = 1; i <= n; ++i)
+        parent[i] = uint32_t(random() % i);
+    shapes.push_back(make_shape("random", parent));
+    return shapes;
+}
+
+typedef wythe::multivector<int> tree_type;
+
+// emplace the nodes in preorder
+static tree_type build_tree(const shape &s) {
+    struct frame {
+        tree_type::cursor c;
+        uint32_t next, end;
+    };
+    tree_type tree;
+    std::vector<frame> stack{{tree.root(), s.first[0], s.first[1]}};
+    while (!stack.empty()) {
+        auto &f = stack.back();
+        if (f.next == f.end) {
+            stack.pop_back();
+            continue;
+        }
+        auto id = s.kids[f.next++];
+        auto c = f.c.emplace(int(id));
+        if (s.first[id] != s.first[id + 1])
+            stack.push_back(frame{c, s.first[id], s.first[id + 1]});
+    }
+    return tree;
+}
+
+// the baseline, a conventional tree of separately allocated nodes
+struct node {
+    int value = 0;
+    node *parent = nullptr;
+    std::vector<std::unique_ptr<node>> children;
+
+    node() {}
+    node(int value, node *parent) : value(value), parent(parent) {}
+
+    node *add(int v) {
+        children.push_back(std::make_unique<node>(v, this));
+        return children.back().get();
+    }
+
+    std::unique_ptr<node> copy(node *p) const {
+        auto n = std::make_unique<node>(value, p);
+        n->children.reserve(children.size());
+        for (auto &c : children)
+            n->children.push_back(c->copy(n.get()));
+        return n;
+    }
+
+    size_t count() const {
+        size_t n = children.size();
+        for (auto &c : children)
+            n += c->count();
+        return n;
+    }
+
+    template <typename F> void recurse(F f) const {
+        for (auto &c : children) {
+            f(*c);
+            c->recurse(f);
+        }
+    }
+
+    void promote_last() {
+        if (children.empty())
+            return;
+        auto last = std::move(children.back());
+        children.pop_back();
+        for (auto &c : last->children) {
+            c->parent = this;
+            children.push_back(std::move(c));
+        }
+    }
+
+    friend bool operator==(const node &a, const node &b) {
+        if (a.value != b.value || a.children.size() != b.children.size())
+            return false;
+        for (size_t i = 0; i < a.children.size(); ++i)
+            if (!(*a.children[i] == *b.children[i]))
+                return false;
+        return true;
+    }
+};
+
+static std::unique_ptr<node> build_nodes(const shape &s) {
+    struct frame {
+        node *n;
+        uint32_t next, end;
+    };
+    auto root = std::make_unique<node>();
+    std::vector<frame> stack{{root.get(), s.first[0], s.first[1]}};
+    while (!stack.empty()) {
+        auto &f = stack.back();
+        if (f.next == f.end) {
+            stack.pop_back();
+            continue;
+        }
+        auto id = s.kids[f.next++];
+        auto c = f.n->add(int(id));
+        if (s.first[id] != s.first[id + 1])
+            stack.push_back(frame{c, s.first[id], s.first[id + 1]});
+    }
+    return root;
+}
+
+// writes one JSON object per measurement into the results array
+struct report {
+    std::ostream &os;
+    bool first = true;
+
+    explicit report(std::ostream &os) : os(os) {
+        os << "{\n  \"benchmark\": \"mvsuite\",\n  \"max_nodes\": " << max_nodes
+           << ",\n  \"results\": [";
+    }
+    ~report() { os << "\n  ]\n}\n"; }
+
+    void add(const shape &s, size_t n, const char *structure, const char *operation, size_t runs,
+             double ns) {
+        os << (first ? "\n" : ",\n") << "    {\"shape\": \"" << s.name << "\", \"nodes\": " << n
+           << ", \"depth\": " << s.depth << ", \"structure\": \"" << structure
+           << "\", \"operation\": \"" << operation << "\", \"runs\": " << runs
+           << ", \"ns\": " << ns / runs << ", \"ns_per_node\": " << ns / runs / n << "}";
+        first = false;
+    }
+};
+
+// Run f runs times, each after an untimed prepare, and report the mean.
+template <typename Prepare, typename F>
+void measure(report &r, const shape &s, size_t n, const char *structure, const char *operation,
+             size_t runs, Prepare prepare, F f) {
+    double ns = 0;
+    for (size_t k = 0; k < runs; ++k) {
+        prepare();
+        wythe::timer t;
+        t.start();
+        f();
+        t.stop();
+        ns += t.nano();
+    }
+    r.add(s, n, structure, operation, runs, ns);
+}
+
+template <typename F>
+void measure(report &r, const shape &s, size_t n, const char *structure, const char *operation,
+             size_t runs, F f) {
+    measure(r, s, n, structure, operation, runs, [] {}, f);
+}
+
+// keeps results from being optimized away
+static volatile size_t sink;
+
+static void suite(report &r, const shape &s, size_t n) {
+    auto runs = std::max<size_t>(1, work / n);
+    const char *mv = "multivector", *nd = "node";
+
+    std::optional<tree_type> built;
+    measure(r, s, n, mv, "emplace", runs, [&] { built.reset(); }, [&] { built = build_tree(s); });
+    const tree_type &tree = *built;
+    std::unique_ptr<node> nodes;
+    measure(r, s, n, nd, "emplace", runs, [&] { nodes.reset(); }, [&] { nodes = build_nodes(s); });
+
+    size_t sum = 0;
+    measure(r, s, n, mv, "recurse", runs, [&] {
+        wythe::recurse(tree.root(), [&](tree_type::const_cursor c) { sum += *c; });
+    });
+    measure(r, s, n, mv, "linear_cursor", runs, [&] {
+        for (auto i = tree_type::const_linear_cursor(tree.begin()); i != tree.end(); ++i)
+            sum += *i;
+    });
+    measure(r, s, n, nd, "recurse", runs, [&] { nodes->recurse([&](const node &c) { sum += c.value; }); });
+
+    std::optional<tree_type> copy;
+    measure(r, s, n, mv, "copy", runs, [&] { copy.reset(); }, [&] { copy.emplace(tree); });
+    std::unique_ptr<node> node_copy;
+    measure(r, s, n, nd, "copy", runs, [&] { node_copy.reset(); },
+            [&] { node_copy = nodes->copy(nullptr); });
+    tree_type moved;
+    measure(r, s, n, mv, "move", runs, [&] { moved = std::move(*copy); *copy = std::move(moved); });
+    std::unique_ptr<node> node_moved;
+    measure(r, s, n, nd, "move", runs, [&] {
+        node_moved = std::move(node_copy);
+        node_copy = std::move(node_moved);
+    });
+
+    measure(r, s, n, mv, "==", runs, [&] { sum += tree == *copy; });
+    measure(r, s, n, mv, "<", runs, [&] { sum += tree < *copy; });
+    measure(r, s, n, nd, "==", runs, [&] { sum += *nodes == *node_copy; });
+
+    measure(r, s, n, mv, "size", runs, [&] { sum += tree.size(); });
+    measure(r, s, n, nd, "size", runs, [&] { sum += nodes->count(); });
+
+    // from the last node in preorder, as deep as the shape goes
+    auto last = tree.root();
+    while (!last.empty())
+        last = last.end() - 1;
+    const node *last_node = nodes.get();
+    while (!last_node->children.empty())
+        last_node = last_node->children.back().get();
+    measure(r, s, n, mv, "get_root", runs, [&] { sum += *wythe::get_root(last).begin(); });
+    measure(r, s, n, nd, "get_root", runs, [&] {
+        auto p = last_node;
+        while (p->parent)
+            p = p->parent;
+        sum += p->children.front()->value;
+    });
+
+    std::optional<tree_type> appended;
+    measure(r, s, n, mv, "append", runs, [&] { appended.emplace(); },
+            [&] { wythe::append(appended->root(), tree.root()); });
+
+    // promote the last child of the root until it has none
+    measure(r, s, n, mv, "promote_last", runs, [&] { copy.emplace(tree); }, [&] {
+        for (auto root = copy->root(); !root.empty();)
+            root.promote_last();
+    });
+    measure(r, s, n, nd, "promote_last", runs, [&] { node_copy = nodes->copy(nullptr); }, [&] {
+        while (!node_copy->children.empty())
+            node_copy->promote_last();
+    });
+
+    measure(r, s, n, mv, "compact_string", runs, [&] { sum += wythe::compact_string(tree).size(); });
+    measure(r, s, n, mv, "to_text", runs, [&] { sum += wythe::to_text(tree).size(); });
+    sink = sum;
+}
+
+int main(int argc, char **argv) {
+    std::string out = "-";
+    try {
+        wythe::command line("mvsuite", "wythe::multivector benchmark suite, as JSON",
+                            "mvsuite [options]");
+        line.add(wythe::option("nodes", 'n', "the largest tree, sizes run from 1000 in powers of 10",
+                               "1000000", [](std::string v) { max_nodes = std::stoul(v); }));
+        line.add(wythe::option("work", 'w', "nodes visited by each operation at each size", "1000000",
+                               [](std::string v) { work = std::stoul(v); }));
+        line.add(wythe::option("out", 'o', "the JSON file, - for standard output", "-",
+                               [&](std::string v) { out = v; }));
+        line.parse(argc, argv);
+
+        std::ofstream file;
+        if (out != "-") {
+            file.open(out);
+            if (!file)
+                throw std::runtime_error("cannot write " + out);
+        }
+        report r(out == "-" ? std::cout : file);
+        for (size_t n = 1000; n <= max_nodes; n *= 10)
+            for (auto &s : make_shapes(n))
+                suite(r, s, n);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
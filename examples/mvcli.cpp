@@ -5,6 +5,7 @@
 #include <string>
 
 #include <wythe/multivector.h>
+#include <wythe/value_index.h>
 #include "command.h"
 
 template <typename T>
@@ -43,19 +44,12 @@ wythe::multivector<int> one() {
     return tree;
 }
 
-#if 0
-// something like this would be cool
-template <typename Cursor>
-Cursor navigate(Cursor parent, Args...) {
-}
-#endif
-
 wythe::multivector<int> two() {
     wythe::multivector<int> tree;
     for (int i = 0; i < 10; ++i) tree.root().emplace_back(i);
     for (int i = 40; i < 50; ++i) (tree.begin() + 5).emplace_back(i);
-    for (int i = 100; i < 103; ++ i) ((tree.begin() + 5).begin() + 3).emplace_back(i);
-    for (int i = 0; i < 10; ++i) ((tree.begin() + 5).begin() + 7).emplace_back(i);
+    for (int i = 100; i < 103; ++ i) wythe::navigate(tree.root(), 5, 3).emplace_back(i);
+    for (int i = 0; i < 10; ++i) wythe::navigate(tree.root(), 5, 7).emplace_back(i);
     wythe::verify(tree);
     return tree;
 }
@@ -147,19 +141,19 @@ void basics() {
     *a++;
     std::swap(a, b);
 
-#if 0
+    wythe::value_index<int> index(tree);
     std::cout << "\nfind 102:\n";
-    auto i = std::find(tree.begin(), tree.end(), 102);
-    if (i != tree.end()) std::cout << "found " << *i << "\n";
+    auto i = index.find(102);
+    if (i != tree.end()) std::cout << "found " << *i << " under " << *i.parent() << "\n";
 
     std::cout << "\nfind 99:\n";
-    i = std::find(tree.begin(), tree.end(), 99);
+    i = index.find(99);
     if (i == tree.end()) std::cout << "not found\n";
 
-    std::cout << "\nfind 43 with reverse cursor starting at tree[5][7][3]\n";
-    auto r = wythe::rfind(tree.root()[5][7][3], "43");
-    if (!r.is_root()) std::cout << "found " << *r << "\n";
-#endif
+    std::cout << "\nfind 43 and print its path\n";
+    i = index.find(43);
+    for (auto k : wythe::path_of(i)) std::cout << k << " ";
+    std::cout << "\n";
 }
 
 void strings() {
@@ -202,6 +196,11 @@ void custom() {
     std::cout << "\nnow create custom message:\n";
     std::cout << wythe::to_text(tree) << "\n";
 
+    auto by_name = [](const Custom & c) -> const std::string & { return c.name; };
+    wythe::value_index<Custom, decltype(by_name)> names(tree, by_name);
+    names.find("goo").assign(Custom{"goo", 16, 23, "b"});
+    std::cout << "\nlook up goo by name:\n" << *names.find("goo") << "\n";
+
     auto sub = wythe::multivector<Custom>(tree.begin());
     std::cout << "\nnow create a sub message:\n";
     std::cout << wythe::to_text(sub) << "\n";
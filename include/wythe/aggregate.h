@@ -0,0 +1,281 @@
+#pragma once
+/*
+        aggregate -- Subtree aggregates kept up to date on mutation.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// A monoid for subtree_aggregate has:
+//
+//   A identity() const                  the aggregate of nothing
+//   A of(const T &value) const          the aggregate of one value
+//   A combine(const A &, const A &) const   associative and commutative
+//   A remove(const A &total, const A &part) const   optional, the inverse
+//   bool keeps(const A &total, const A &part) const optional, true if total
+//                                       stays the same without part
+//
+// With remove(), every update is O(depth).  Without it, removals and
+// assignments recompute the ancestors from their children, O(depth * fan-out),
+// stopping at the first one that keeps its aggregate.
+
+template <typename A, typename Extract = std::identity> struct sum_monoid {
+    Extract f = Extract();
+    A identity() const { return A(); }
+    template <typename V> A of(const V &v) const { return A(std::invoke(f, v)); }
+    A combine(const A &a, const A &b) const { return a + b; }
+    A remove(const A &total, const A &part) const { return total - part; }
+};
+
+template <typename A, typename Extract = std::identity> struct max_monoid {
+    Extract f = Extract();
+    A identity() const { return std::numeric_limits<A>::lowest(); }
+    template <typename V> A of(const V &v) const { return A(std::invoke(f, v)); }
+    A combine(const A &a, const A &b) const { return std::max(a, b); }
+    bool keeps(const A &total, const A &part) const { return part < total; }
+};
+
+template <typename A, typename Extract = std::identity> struct min_monoid {
+    Extract f = Extract();
+    A identity() const { return std::numeric_limits<A>::max(); }
+    template <typename V> A of(const V &v) const { return A(std::invoke(f, v)); }
+    A combine(const A &a, const A &b) const { return std::min(a, b); }
+    bool keeps(const A &total, const A &part) const { return total < part; }
+};
+
+// Caches the aggregate of every subtree of a tree: the value of an item
+// combined with the aggregates of its children.  The root has no value of its
+// own, so the aggregate of the root is that of the whole tree.
+//
+// The cache observes the tree.  emplace, pop_back and assign() update the
+// ancestors of the changed item only; clear, promote_last and compact work on
+// the affected items.  aggregate(c) is a hash lookup.  Plain *c = v is not
+// observed, use c.assign(v).
+template <typename T, typename Monoid> struct subtree_aggregate : mutation_observer<T> {
+    typedef typename multivector<T>::cursor cursor;
+    typedef std::remove_cvref_t<decltype(std::declval<const Monoid &>().identity())> value_type;
+
+    explicit subtree_aggregate(multivector<T> &tree, Monoid m = Monoid())
+        : tree(tree), m(std::move(m)) {
+        rebuild();
+        tree.observe(this);
+    }
+    ~subtree_aggregate() { tree.unobserve(this); }
+
+    subtree_aggregate(const subtree_aggregate &) = delete;
+    subtree_aggregate &operator=(const subtree_aggregate &) = delete;
+
+    // the aggregate of the subtree at c, throws std::out_of_range if c is not
+    // an item of the tree
+    template <typename Cursor> const value_type &aggregate(Cursor c) const {
+        auto i = aggs.find(c.it_);
+        if (i == aggs.end())
+            throw std::out_of_range("subtree_aggregate: not an item of the tree");
+        return i->second;
+    }
+
+    // the aggregate of the whole tree
+    const value_type &total() const { return aggregate(tree.root()); }
+
+    void rebuild() {
+        aggs.clear();
+        aggs.reserve(tree.size() + 1);
+        build(tree.root().it_);
+    }
+
+    void emplaced(cursor p) override {
+        auto a = m.of(p.it_->nodes_.back().value);
+        aggs.emplace(&p.it_->nodes_.back(), a);
+        for (auto x = p.it_;; x = x->parent_item()) {
+            auto &ax = aggs[x];
+            ax = m.combine(ax, a);
+            if (x->is_root())
+                break;
+        }
+    }
+
+    void popping(cursor p) override {
+        auto &n = p.it_->nodes_;
+        if (n.empty())
+            return;
+        auto last = &n.back();
+        auto a = aggs[last];
+        erase_subtree(last);
+        if constexpr (invertible)
+            subtract_path(p.it_, a);
+        else if (!keeps(aggs[p.it_], a)) {
+            auto ap = lift(p.it_);
+            for (size_t k = 0; k + 1 < n.size(); ++k)
+                ap = m.combine(ap, aggs[&n[k]]);
+            set_path(p.it_, ap);
+        }
+    }
+
+    void clearing(cursor p) override {
+        for (auto &i : p.it_->nodes_)
+            erase_subtree(&i);
+        if constexpr (invertible)
+            subtract_path(p.it_, m.remove(aggs[p.it_], lift(p.it_)));
+        else
+            set_path(p.it_, lift(p.it_));
+    }
+
+    void promoting(cursor p) override {
+        auto &n = p.it_->nodes_;
+        if (n.empty())
+            return;
+        // the children's aggregates in their order after promotion
+        moving.clear();
+        for (size_t k = 0; k + 1 < n.size(); ++k)
+            moving.push_back(take(&n[k]));
+        auto &last = n.back();
+        for (auto &i : last.nodes_)
+            moving.push_back(take(&i));
+        auto a = m.of(last.value);
+        aggs.erase(&last);
+        if constexpr (invertible)
+            subtract_path(p.it_, a);
+        else if (!keeps(aggs[p.it_], a)) {
+            auto ap = lift(p.it_);
+            for (auto &x : moving)
+                ap = m.combine(ap, x);
+            set_path(p.it_, ap);
+        }
+    }
+    void promoted(cursor p) override { restore(p.it_); }
+
+    void relocating(cursor p) override {
+        moving.clear();
+        for (auto &i : p.it_->nodes_)
+            moving.push_back(take(&i));
+    }
+    void relocated(cursor p) override { restore(p.it_); }
+
+    void compacting(cursor p) override {
+        for (auto &i : p.it_->nodes_)
+            erase_subtree(&i);
+    }
+    void compacted(cursor p) override {
+        for (auto &i : p.it_->nodes_)
+            build(&i);
+    }
+
+    void assigning(cursor c) override { before = m.of(c.it_->value); }
+    void assigned(cursor c) override {
+        auto x = c.it_;
+        if constexpr (invertible) {
+            auto a = m.of(x->value);
+            for (;; x = x->parent_item()) {
+                auto &ax = aggs[x];
+                ax = m.combine(m.remove(ax, before), a);
+                if (x->is_root())
+                    break;
+            }
+        } else {
+            auto a = aggs[x];
+            set_path(x, keeps(a, before) ? m.combine(a, m.of(x->value)) : compute(x));
+        }
+    }
+
+    void replaced(multivector<T> &) override { rebuild(); }
+
+  private:
+    typedef item<T> item_type;
+
+    static constexpr bool invertible =
+        requires(const Monoid &m, const value_type &a) { m.remove(a, a); };
+
+    value_type lift(const item_type *i) const {
+        return i->is_root() ? m.identity() : m.of(i->value);
+    }
+
+    // the aggregate of i from the cached aggregates of its children
+    value_type compute(const item_type *i) {
+        auto a = lift(i);
+        for (auto &c : i->nodes_)
+            a = m.combine(a, aggs[&c]);
+        return a;
+    }
+
+    const value_type &build(const item_type *i) {
+        auto a = lift(i);
+        for (auto &c : i->nodes_)
+            a = m.combine(a, build(&c));
+        return aggs[i] = a;
+    }
+
+    static constexpr bool has_keeps =
+        requires(const Monoid &m, const value_type &a) { m.keeps(a, a); };
+
+    bool keeps(const value_type &total, const value_type &part) const {
+        if constexpr (has_keeps)
+            return m.keeps(total, part);
+        else
+            return false;
+    }
+
+    // set the aggregate of x, and update its ancestors until one is unchanged
+    void set_path(const item_type *x, value_type a) {
+        auto &ax = aggs[x];
+        auto old = std::move(ax);
+        ax = std::move(a);
+        while (!x->is_root()) {
+            if constexpr (std::equality_comparable<value_type>)
+                if (old == aggs[x])
+                    return;
+            auto &np = aggs[x->parent_item()];
+            // the parent lost old and gained the new aggregate of x
+            auto next = keeps(np, old) ? m.combine(np, aggs[x]) : compute(x->parent_item());
+            x = x->parent_item();
+            old = std::move(np);
+            np = std::move(next);
+        }
+    }
+
+    // remove part from the aggregates of x and its ancestors
+    void subtract_path(const item_type *x, const value_type &part) {
+        for (;; x = x->parent_item()) {
+            auto &ax = aggs[x];
+            ax = m.remove(ax, part);
+            if (x->is_root())
+                break;
+        }
+    }
+
+    value_type take(const item_type *i) {
+        auto j = aggs.find(i);
+        auto a = std::move(j->second);
+        aggs.erase(j);
+        return a;
+    }
+
+    void restore(const item_type *p) {
+        for (size_t k = 0; k < moving.size(); ++k)
+            aggs[&p->nodes_[k]] = std::move(moving[k]);
+        moving.clear();
+    }
+
+    void erase_subtree(const item_type *i) {
+        aggs.erase(i);
+        for (auto &c : i->nodes_)
+            erase_subtree(&c);
+    }
+
+    multivector<T> &tree;
+    Monoid m;
+    std::unordered_map<const item_type *, value_type> aggs;
+    std::vector<value_type> moving; // aggregates of children about to move
+    value_type before;              // the value's aggregate before assignment
+};
+
+} // namespace wythe
@@ -0,0 +1,135 @@
+#pragma once
+/*
+        concurrent_children -- Lock-free appends of children from many threads.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// Collects values appended concurrently by many threads, to become the
+// children of one item.
+//
+// emplace_back() reserves an index with one atomic increment and constructs
+// the value in place.  Values live in segments that never move: segment k
+// holds 64 << k values, so an index maps to its segment and offset with a few
+// bit operations, and a segment is allocated by the first thread to reach it
+// (a compare and swap, the loser frees its copy).  No appender waits for
+// another.  Each segment ends with a flag per value, set once the value is
+// constructed, so an index whose constructor or segment allocation threw is
+// skipped rather than sealed or destroyed.
+//
+// Once the appending threads are done, seal(parent) moves the values, in
+// index order, to the end of parent's children as one contiguous subvector.
+// The values appended by one thread keep their order.  In an observed tree
+// the children that move to make room are reported, and every sealed value
+// as an emplace.
+template <typename T> struct concurrent_children {
+    concurrent_children() : next(0), done(0), failed(0) {
+        for (auto &s : segments)
+            s.store(nullptr, std::memory_order_relaxed);
+    }
+    ~concurrent_children() { release(); }
+
+    concurrent_children(const concurrent_children &) = delete;
+    concurrent_children &operator=(const concurrent_children &) = delete;
+
+    // lock-free; returns the index of the new value.  If T's constructor
+    // throws, the exception propagates and the index is left empty.
+    template <class... Args> size_t emplace_back(Args &&... args) {
+        auto i = next.fetch_add(1, std::memory_order_relaxed);
+        auto k = segment_of(i);
+        try {
+            auto s = segment(k);
+            new (s + offset(i, k)) T(std::forward<Args>(args)...);
+            built(s, k)[offset(i, k)] = true;
+        } catch (...) {
+            failed.fetch_add(1, std::memory_order_release);
+            throw;
+        }
+        done.fetch_add(1, std::memory_order_release);
+        return i;
+    }
+
+    // the number of values appended so far
+    size_t size() const { return done.load(std::memory_order_acquire); }
+
+    // Move the values to the end of parent's children and empty this.  No
+    // emplace_back may run at the same time; throws std::logic_error if one is
+    // still in progress.
+    template <typename Cursor> void seal(Cursor parent) {
+        auto n = next.load(std::memory_order_acquire);
+        auto m = done.load(std::memory_order_acquire);
+        if (m + failed.load(std::memory_order_acquire) != n)
+            throw std::logic_error("concurrent_children: seal during emplace_back");
+        parent.reserve(parent.size() + m);
+        for (size_t k = 0, i = 0; i < n; i += first << k, ++k) {
+            auto s = segments[k].load(std::memory_order_acquire);
+            if (!s)
+                continue;
+            auto b = built(s, k);
+            for (size_t j = 0; j < (first << k) && i + j < n; ++j)
+                if (b[j])
+                    parent.emplace_back(std::move(s[j]));
+        }
+        release();
+    }
+
+  private:
+    static constexpr size_t first = 64;
+    static constexpr int first_bits = 7; // std::bit_width(first)
+
+    static size_t segment_of(size_t i) { return std::bit_width(i + first) - first_bits; }
+    static size_t offset(size_t i, size_t k) { return i + first - (first << k); }
+
+    // the constructed flags that follow the values of segment k
+    static bool *built(T *s, size_t k) { return reinterpret_cast<bool *>(s + (first << k)); }
+
+    T *segment(size_t k) {
+        auto s = segments[k].load(std::memory_order_acquire);
+        if (s)
+            return s;
+        auto fresh = static_cast<T *>(::operator new((sizeof(T) + sizeof(bool)) * (first << k),
+                                                     std::align_val_t(alignof(T))));
+        std::fill_n(built(fresh, k), first << k, false);
+        if (segments[k].compare_exchange_strong(s, fresh, std::memory_order_acq_rel))
+            return fresh;
+        ::operator delete(fresh, std::align_val_t(alignof(T)));
+        return s;
+    }
+
+    // destroy the values and free the segments
+    void release() {
+        for (size_t k = 0; k < std::size(segments); ++k) {
+            auto s = segments[k].load();
+            if (!s)
+                continue;
+            auto b = built(s, k);
+            for (size_t j = 0; j < (first << k); ++j)
+                if (b[j])
+                    s[j].~T();
+            ::operator delete(s, std::align_val_t(alignof(T)));
+            segments[k].store(nullptr);
+        }
+        next = 0;
+        done = 0;
+        failed = 0;
+    }
+
+    std::atomic<T *> segments[58];
+    alignas(64) std::atomic<size_t> next; // the next index to reserve
+    alignas(64) std::atomic<size_t> done; // the values constructed
+    std::atomic<size_t> failed;           // the indices whose emplace_back threw
+};
+
+} // namespace wythe
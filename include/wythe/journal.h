@@ -0,0 +1,315 @@
+#pragma once
+/*
+        journal -- An append-only log of multivector mutations.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "serialize.h"
+
+namespace wythe {
+
+// A journal file is a header followed by one record per mutation:
+//
+//   "mvj" version | generation | record ...
+//   record: varint length | op | varint depth | child index ... | value
+//
+// The child indices locate the item from the root.  Emplace and assign
+// records end with the value, written by codec<value_type>.  A record cut
+// short by a crash is ignored.
+//
+// A checkpoint writes the header and the whole tree, in the binary
+// serialization format, to path + ".checkpoint", then starts a new journal
+// with the next generation.  Replay applies a journal only to the checkpoint
+// of the same generation, so a crash between the two steps is harmless.
+
+namespace detail {
+static const char journal_magic[4] = {'m', 'v', 'j', 1};
+
+enum journal_op : char {
+    journal_emplace = 1,
+    journal_pop_back,
+    journal_clear,
+    journal_promote_last,
+    journal_assign
+};
+
+// read a whole file, return false if it cannot be opened
+inline bool read_file(const std::string &path, std::string &s) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    s.clear();
+    char buf[64 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) != 0)
+        s.append(buf, n);
+    fclose(f);
+    return true;
+}
+
+// read the header, return the generation
+inline uint64_t read_journal_header(memory_source &source) {
+    char m[4];
+    uint64_t generation;
+    source.read(m, 4);
+    if (memcmp(m, journal_magic, 4) != 0)
+        throw std::runtime_error("journal: not a multivector journal");
+    source.read((char *)&generation, sizeof(generation));
+    return generation;
+}
+
+// the generation in the header of the file at path, false if there is none
+inline bool read_generation(const std::string &path, uint64_t &generation) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    char h[4 + sizeof(uint64_t)];
+    bool ok = fread(h, 1, sizeof(h), f) == sizeof(h) && memcmp(h, journal_magic, 4) == 0;
+    fclose(f);
+    if (ok)
+        memcpy(&generation, h + 4, sizeof(generation));
+    return ok;
+}
+
+// the records of a journal that are complete, s is the journal past its header
+inline size_t complete_records(const std::string &s, size_t first) {
+    memory_source source(s.data() + first, s.data() + s.size());
+    while (!source.empty()) {
+        auto record = source.p;
+        try {
+            auto n = read_varint(source);
+            if (n > size_t(source.last - source.p))
+                return record - s.data();
+            source.p += n;
+        } catch (std::runtime_error &) {
+            return record - s.data();
+        }
+    }
+    return s.size();
+}
+} // namespace detail
+
+// Records the mutations made through the cursors of a tree, see
+// mutation_observer, so that replay() can rebuild it after a crash.  The cost
+// is proportional to the edits, not the size of the tree.
+template <typename T> struct mutation_journal : mutation_observer<T> {
+    typedef typename multivector<T>::cursor cursor;
+
+    // Journal tree to path.  An existing journal is continued, so tree must
+    // be what replay(path) returned; otherwise tree is checkpointed first.  A
+    // journal of another generation than the checkpoint, left by a crash
+    // during a checkpoint, is not continued either.
+    mutation_journal(multivector<T> &tree, std::string path)
+        : tree(tree), path(std::move(path)), f(nullptr), generation(0), records_(0) {
+        std::string s;
+        uint64_t saved = 0;
+        bool checkpointed = detail::read_generation(this->path + ".checkpoint", saved);
+        if (detail::read_file(this->path, s) && s.size() >= header_size) {
+            memory_source source(s);
+            generation = detail::read_journal_header(source);
+            if (checkpointed && generation == saved &&
+                detail::complete_records(s, header_size) == s.size()) {
+                f = fopen(this->path.c_str(), "ab");
+                if (!f)
+                    throw std::runtime_error("mutation_journal: cannot open " + this->path);
+            }
+        }
+        if (!f) {
+            generation = std::max(generation, saved);
+            checkpoint();
+        }
+        tree.observe(this);
+    }
+
+    ~mutation_journal() {
+        tree.unobserve(this);
+        if (f)
+            fclose(f);
+    }
+
+    mutation_journal(const mutation_journal &) = delete;
+    mutation_journal &operator=(const mutation_journal &) = delete;
+
+    void emplaced(cursor parent) override {
+        record(detail::journal_emplace, parent, &*(parent.end() - 1));
+    }
+    void popping(cursor parent) override { record(detail::journal_pop_back, parent); }
+    void clearing(cursor parent) override { record(detail::journal_clear, parent); }
+    void promoting(cursor parent) override { record(detail::journal_promote_last, parent); }
+    void assigned(cursor c) override { record(detail::journal_assign, c, &*c); }
+    // Whole tree assignment, which may be the noexcept move, cannot throw:
+    // if the checkpoint fails, the next record or flush() retries it and
+    // throws if it fails again.
+    void replaced(multivector<T> &) override {
+        try {
+            checkpoint();
+        } catch (...) {
+            failed = std::current_exception();
+        }
+    }
+
+    // write buffered records to the operating system
+    void flush() {
+        recover();
+        if (fflush(f) != 0)
+            throw std::runtime_error("mutation_journal: write failed");
+    }
+
+    // flush, then wait until the records are on disk
+    void sync() {
+        flush();
+#ifndef _WIN32
+        fsync(fileno(f));
+#endif
+    }
+
+    // write the whole tree and start an empty journal
+    void checkpoint() {
+        failed = nullptr;
+        if (f)
+            fclose(f);
+        f = nullptr;
+        ++generation;
+        auto name = path + ".checkpoint";
+        auto temp = name + ".tmp";
+        FILE *c = fopen(temp.c_str(), "wb");
+        if (!c)
+            throw std::runtime_error("mutation_journal: cannot open " + temp);
+        write_header(c);
+        serialize(tree, file_sink(c));
+        close(c);
+        if (std::rename(temp.c_str(), name.c_str()) != 0)
+            throw std::runtime_error("mutation_journal: cannot rename " + temp);
+        f = fopen(path.c_str(), "wb");
+        if (!f)
+            throw std::runtime_error("mutation_journal: cannot open " + path);
+        write_header(f);
+        sync();
+        records_ = 0;
+    }
+
+    // records since the last checkpoint
+    size_t records() const { return records_; }
+
+  private:
+    static const size_t header_size = 4 + sizeof(uint64_t);
+
+    void write_header(FILE *file) {
+        if (fwrite(detail::journal_magic, 1, 4, file) != 4 ||
+            fwrite(&generation, sizeof(generation), 1, file) != 1)
+            throw std::runtime_error("mutation_journal: write failed");
+    }
+
+    void close(FILE *file) {
+        bool ok = fflush(file) == 0;
+#ifndef _WIN32
+        ok = ok && fsync(fileno(file)) == 0;
+#endif
+        ok = fclose(file) == 0 && ok;
+        if (!ok)
+            throw std::runtime_error("mutation_journal: write failed");
+    }
+
+    // retry a failed checkpoint, return true if one was taken
+    bool recover() {
+        if (!failed)
+            return false;
+        try {
+            checkpoint();
+        } catch (...) {
+            failed = std::current_exception();
+            throw;
+        }
+        return true;
+    }
+
+    void record(detail::journal_op op, cursor c, const T *value = nullptr) {
+        // a checkpoint taken now already has the emplace or assignment
+        if (recover() && (op == detail::journal_emplace || op == detail::journal_assign))
+            return;
+        indices.clear();
+        for (; !c.is_root(); c = c.parent())
+            indices.push_back(c.it_ - c.v->data());
+        buf.clear();
+        string_sink sink(buf);
+        buf += char(op);
+        write_varint(sink, indices.size());
+        for (auto i = indices.rbegin(); i != indices.rend(); ++i)
+            write_varint(sink, *i);
+        if (value)
+            codec<T>::write(sink, *value);
+        file_sink out(f);
+        write_varint(out, buf.size());
+        out.write(buf.data(), buf.size());
+        ++records_;
+    }
+
+    multivector<T> &tree;
+    std::string path;
+    FILE *f;
+    uint64_t generation;
+    size_t records_;
+    std::exception_ptr failed;   // the error of a checkpoint in replaced()
+    std::string buf;             // the record being written
+    std::vector<size_t> indices; // the path of the record, leaf first
+};
+
+// Rebuild the tree recorded by a mutation_journal at path: the last
+// checkpoint with the complete records of its journal applied.  Throws
+// std::runtime_error if a record does not fit the tree.
+template <typename T> multivector<T> replay(const std::string &path) {
+    std::string s;
+    if (!detail::read_file(path + ".checkpoint", s))
+        return multivector<T>();
+    memory_source checkpoint(s);
+    auto generation = detail::read_journal_header(checkpoint);
+    auto tree = deserialize<T>(checkpoint);
+
+    if (!detail::read_file(path, s) || s.size() < 4 + sizeof(uint64_t))
+        return tree;
+    memory_source source(s);
+    if (detail::read_journal_header(source) != generation)
+        return tree; // the checkpoint already includes this journal
+    source.last = s.data() + detail::complete_records(s, source.p - s.data());
+    while (!source.empty()) {
+        auto n = read_varint(source);
+        memory_source r(source.p, source.p + n);
+        source.p += n;
+        char op;
+        r.read(&op, 1);
+        auto c = tree.root();
+        for (auto depth = read_varint(r); depth; --depth) {
+            auto i = read_varint(r);
+            if (i >= c.size())
+                throw std::runtime_error("replay: record does not fit the tree");
+            c = c.begin() + i;
+        }
+        switch (op) {
+        case detail::journal_emplace: c.emplace_back(codec<T>::read(r)); break;
+        case detail::journal_assign: *c = codec<T>::read(r); break;
+        case detail::journal_clear: c.clear(); break;
+        case detail::journal_promote_last: c.promote_last(); break;
+        case detail::journal_pop_back:
+            if (c.empty())
+                throw std::runtime_error("replay: record does not fit the tree");
+            c.pop_back();
+            break;
+        default: throw std::runtime_error("replay: unknown record");
+        }
+    }
+    return tree;
+}
+
+} // namespace wythe
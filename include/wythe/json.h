@@ -0,0 +1,361 @@
+#pragma once
+/*
+        json -- Streaming JSON import into multivectors.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <charconv>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// One JSON value.  Objects and arrays are items whose children are their
+// members and elements, and the name of an object member is its key.
+struct json_node {
+    enum kind_type { null, boolean, number, string, array, object };
+
+    json_node() : kind(null) {}
+    json_node(kind_type kind, std::string key = std::string(),
+              std::string text = std::string())
+        : kind(kind), key(std::move(key)), text(std::move(text)) {}
+
+    double as_number() const {
+        double v = 0;
+        std::from_chars(text.data(), text.data() + text.size(), v);
+        return v;
+    }
+    bool as_bool() const { return kind == boolean && text == "true"; }
+
+    friend bool operator==(const json_node &a, const json_node &b) {
+        return a.kind == b.kind && a.key == b.key && a.text == b.text;
+    }
+    friend bool operator!=(const json_node &a, const json_node &b) { return !(a == b); }
+    friend bool operator<(const json_node &a, const json_node &b) {
+        if (a.kind != b.kind)
+            return a.kind < b.kind;
+        if (a.key != b.key)
+            return a.key < b.key;
+        return a.text < b.text;
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const json_node &n) {
+        if (!n.key.empty())
+            os << n.key << ": ";
+        switch (n.kind) {
+        case null: return os << "null";
+        case string: return os << '"' << n.text << '"';
+        case array: return os << "[]";
+        case object: return os << "{}";
+        default: return os << n.text;
+        }
+    }
+
+    kind_type kind;
+    std::string key;  // member name, empty for elements and top level values
+    std::string text; // the characters of a string, a number, "true" or "false"
+};
+
+// Streaming JSON parser.  Text is fed in chunks of any size, and each value
+// is reported to a Builder, such as tree_builder, as soon as it starts:
+//
+//     value(json_node &&)  a value; for an object or array children follow
+//     start_children()     the members or elements of the last value follow
+//     end_children()
+//
+// so no intermediate document is built.  Top level values may follow one
+// another, as in JSON lines, and each becomes a top level item.
+template <typename Builder> struct json_parser {
+    explicit json_parser(Builder &builder)
+        : b(builder), state(scan), expect(value), offset(0), high(0) {}
+
+    void feed(std::string_view s) {
+        size_t i = 0;
+        while (i < s.size()) {
+            char ch = s[i];
+            switch (state) {
+            case scan:
+                if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t')
+                    ++i;
+                else
+                    i += token(s, i);
+                break;
+            case in_string: {
+                auto j = i;
+                while (j < s.size() && s[j] != '"' && s[j] != '\\' && (unsigned char)s[j] >= 0x20)
+                    ++j;
+                if (j != i) {
+                    flush_high();
+                    text.append(s.data() + i, j - i);
+                }
+                i = j;
+                if (i == s.size())
+                    break;
+                if (s[i] == '"')
+                    end_string();
+                else if (s[i] == '\\')
+                    state = in_escape;
+                else
+                    error(offset + i, "control character in string");
+                ++i;
+                break;
+            }
+            case in_escape:
+                escape(ch, offset + i);
+                ++i;
+                break;
+            case in_unicode:
+                unicode(ch, offset + i);
+                ++i;
+                break;
+            case in_number:
+                if ((ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.' ||
+                    ch == 'e' || ch == 'E') {
+                    text += ch;
+                    ++i;
+                } else
+                    end_number(offset + i);
+                break;
+            case in_literal:
+                if (ch >= 'a' && ch <= 'z') {
+                    text += ch;
+                    ++i;
+                } else
+                    end_literal(offset + i);
+                break;
+            }
+        }
+        offset += s.size();
+    }
+
+    // check that the input was complete
+    void finish() {
+        if (state == in_number)
+            end_number(offset);
+        else if (state == in_literal)
+            end_literal(offset);
+        if (state != scan)
+            error(offset, "unterminated string");
+        if (!containers.empty() || expect != value)
+            error(offset, "unexpected end of input");
+    }
+
+  private:
+    enum state_type { scan, in_string, in_escape, in_unicode, in_number, in_literal };
+    enum expect_type { value, value_or_end, key, key_or_end, colon, comma_or_end };
+
+    // start a token at s[i], return the number of characters used
+    size_t token(std::string_view s, size_t i) {
+        char ch = s[i];
+        auto at = offset + i;
+        switch (ch) {
+        case '{':
+            start_value(json_node::object, at);
+            b.start_children();
+            containers.push_back('{');
+            expect = key_or_end;
+            return 1;
+        case '[':
+            start_value(json_node::array, at);
+            b.start_children();
+            containers.push_back('[');
+            expect = value_or_end;
+            return 1;
+        case '}':
+        case ']':
+            if (containers.empty() || containers.back() != (ch == '}' ? '{' : '[') ||
+                (expect != comma_or_end && expect != (ch == '}' ? key_or_end : value_or_end)))
+                error(at, "unexpected close");
+            b.end_children();
+            containers.pop_back();
+            after_value();
+            return 1;
+        case ',':
+            if (expect != comma_or_end)
+                error(at, "unexpected ','");
+            expect = containers.back() == '{' ? key : value;
+            return 1;
+        case ':':
+            if (expect != colon)
+                error(at, "unexpected ':'");
+            expect = value;
+            return 1;
+        case '"':
+            if (expect != key && expect != key_or_end && expect != value &&
+                expect != value_or_end)
+                error(at, "unexpected string");
+            state = in_string;
+            text.clear();
+            return 1;
+        default:
+            text.assign(1, ch);
+            if (ch == '-' || (ch >= '0' && ch <= '9'))
+                state = in_number;
+            else if (ch >= 'a' && ch <= 'z')
+                state = in_literal;
+            else
+                error(at, "unexpected character");
+            return 1;
+        }
+    }
+
+    void start_value(json_node::kind_type kind, size_t at, std::string t = std::string()) {
+        if (expect != value && expect != value_or_end)
+            error(at, "unexpected value");
+        b.value(json_node(kind, std::move(name), std::move(t)));
+        name.clear();
+    }
+
+    void after_value() { expect = containers.empty() ? value : comma_or_end; }
+
+    void end_string() {
+        flush_high();
+        state = scan;
+        if (expect == key || expect == key_or_end) {
+            name = std::move(text);
+            expect = colon;
+        } else {
+            start_value(json_node::string, offset, std::move(text));
+            after_value();
+        }
+        text.clear();
+    }
+
+    void end_number(size_t at) {
+        state = scan;
+        double v;
+        auto r = std::from_chars(text.data(), text.data() + text.size(), v);
+        if (r.ec != std::errc() || r.ptr != text.data() + text.size())
+            error(at, "invalid number");
+        start_value(json_node::number, at, std::move(text));
+        after_value();
+        text.clear();
+    }
+
+    void end_literal(size_t at) {
+        state = scan;
+        if (text == "true" || text == "false")
+            start_value(json_node::boolean, at, std::move(text));
+        else if (text == "null")
+            start_value(json_node::null, at);
+        else
+            error(at, "invalid literal");
+        after_value();
+        text.clear();
+    }
+
+    void escape(char ch, size_t at) {
+        state = in_string;
+        if (ch == 'u') {
+            state = in_unicode;
+            code = 0;
+            digits = 0;
+            return;
+        }
+        flush_high();
+        switch (ch) {
+        case '"': text += '"'; break;
+        case '\\': text += '\\'; break;
+        case '/': text += '/'; break;
+        case 'b': text += '\b'; break;
+        case 'f': text += '\f'; break;
+        case 'n': text += '\n'; break;
+        case 'r': text += '\r'; break;
+        case 't': text += '\t'; break;
+        default: error(at, "invalid escape");
+        }
+    }
+
+    void unicode(char ch, size_t at) {
+        int d = (ch >= '0' && ch <= '9') ? ch - '0'
+              : (ch >= 'a' && ch <= 'f') ? ch - 'a' + 10
+              : (ch >= 'A' && ch <= 'F') ? ch - 'A' + 10 : -1;
+        if (d < 0)
+            error(at, "invalid \\u escape");
+        code = code * 16 + d;
+        if (++digits < 4)
+            return;
+        state = in_string;
+        if (code >= 0xd800 && code < 0xdc00) {
+            flush_high();
+            high = code;
+        } else if (code >= 0xdc00 && code < 0xe000 && high) {
+            utf8(0x10000 + ((high - 0xd800) << 10) + (code - 0xdc00));
+            high = 0;
+        } else {
+            flush_high();
+            utf8(code);
+        }
+    }
+
+    // an unpaired high surrogate is kept as is
+    void flush_high() {
+        if (high) {
+            utf8(high);
+            high = 0;
+        }
+    }
+
+    void utf8(uint32_t c) {
+        if (c < 0x80)
+            text += char(c);
+        else if (c < 0x800) {
+            text += char(0xc0 | (c >> 6));
+            text += char(0x80 | (c & 0x3f));
+        } else if (c < 0x10000) {
+            text += char(0xe0 | (c >> 12));
+            text += char(0x80 | ((c >> 6) & 0x3f));
+            text += char(0x80 | (c & 0x3f));
+        } else {
+            text += char(0xf0 | (c >> 18));
+            text += char(0x80 | ((c >> 12) & 0x3f));
+            text += char(0x80 | ((c >> 6) & 0x3f));
+            text += char(0x80 | (c & 0x3f));
+        }
+    }
+
+    [[noreturn]] static void error(size_t at, const char *what) {
+        std::ostringstream os;
+        os << "json_parser: " << what << " at offset " << at;
+        throw std::runtime_error(os.str());
+    }
+
+    Builder &b;
+    state_type state;
+    expect_type expect;
+    std::vector<char> containers; // '{' or '[' for each open container
+    std::string text;             // the token being read
+    std::string name;             // the key of the next object member
+    size_t offset;
+    uint32_t code, digits, high;
+};
+
+// parse JSON text into a multivector, T is constructed from a json_node
+template <typename T = json_node> multivector<T> parse_json(std::string_view s) {
+    tree_builder<T> builder;
+    json_parser<tree_builder<T>> parser(builder);
+    parser.feed(s);
+    parser.finish();
+    return builder.finish();
+}
+
+// parse JSON from a stream, reading it in large chunks
+template <typename T = json_node> multivector<T> parse_json(std::istream &is) {
+    tree_builder<T> builder;
+    json_parser<tree_builder<T>> parser(builder);
+    std::vector<char> buf(64 * 1024);
+    while (is.read(buf.data(), buf.size()) || is.gcount())
+        parser.feed(std::string_view(buf.data(), is.gcount()));
+    parser.finish();
+    return builder.finish();
+}
+
+} // namespace wythe
@@ -0,0 +1,257 @@
+#pragma once
+/*
+        lazy_multivector -- A read-only multivector loaded from disk on demand.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <list>
+#include <unordered_map>
+
+#include "multivector_view.h"
+
+namespace wythe {
+
+// A lazy_multivector reads a file written by write_view, whose breadth-first
+// item table is the index: the children of any item are one contiguous run
+// of items, values and blob.  Opening reads only the header.  Each subvector
+// is read with a few preads the first time it is needed and kept in a least
+// recently used cache of at most max_resident subvectors.
+
+template <typename T> struct lazy_multivector;
+
+namespace detail {
+// the values of a subvector, read from its part of the values array and blob
+template <typename T> struct lazy_values {
+    static std::pair<uint64_t, uint64_t> blob_range(const std::vector<char> &, size_t) {
+        return {0, 0};
+    }
+    static void read(const std::vector<char> &values, const std::vector<char> &, uint64_t,
+                     size_t n, std::vector<T> &out) {
+        out.resize(n);
+        memcpy(out.data(), values.data(), n * sizeof(T));
+    }
+};
+
+// the strings of a subvector are one run of the blob, each string has been
+// checked to lie within the blob but not within the run
+template <> struct lazy_values<std::string> {
+    static std::pair<uint64_t, uint64_t> blob_range(const std::vector<char> &values, size_t n) {
+        auto r = reinterpret_cast<const uint64_t *>(values.data());
+        auto range = std::make_pair(r[0], r[2 * (n - 1)] + r[2 * (n - 1) + 1]);
+        if (range.second < range.first)
+            throw std::runtime_error("lazy_multivector: corrupt values");
+        return range;
+    }
+    static void read(const std::vector<char> &values, const std::vector<char> &blob,
+                     uint64_t offset, size_t n, std::vector<std::string> &out) {
+        auto r = reinterpret_cast<const uint64_t *>(values.data());
+        out.reserve(n);
+        for (size_t k = 0; k < n; ++k) {
+            if (r[2 * k] < offset || r[2 * k + 1] > blob.size() ||
+                r[2 * k] - offset > blob.size() - r[2 * k + 1])
+                throw std::runtime_error("lazy_multivector: corrupt values");
+            out.emplace_back(blob.data() + (r[2 * k] - offset), r[2 * k + 1]);
+        }
+    }
+};
+} // namespace detail
+
+// A const cursor into a lazy_multivector.  Cursors are indices, so they stay
+// valid when the subvectors they refer to are evicted.  Values are returned
+// by value for the same reason.  Cursor specific operations may read the
+// subvector holding the item.
+template <typename T> using lazy_cursor = index_cursor<lazy_multivector<T>>;
+template <typename T> using lazy_linear_cursor = index_linear_cursor<lazy_multivector<T>>;
+
+// A read-only multivector whose subvectors are read from a file written by
+// write_view as cursors reach them.  Not safe for concurrent use, since
+// reading through a cursor updates the cache.
+template <typename T> struct lazy_multivector {
+    typedef T value_type;
+    typedef T reference;
+    typedef lazy_cursor<T> const_cursor;
+    typedef const_cursor cursor;
+    typedef lazy_linear_cursor<T> const_linear_cursor;
+    typedef detail::lazy_values<T> values_type;
+
+    lazy_multivector(const lazy_multivector &) = delete;
+    lazy_multivector &operator=(const lazy_multivector &) = delete;
+    lazy_multivector(lazy_multivector &&b) noexcept
+        : fd(b.fd), header(b.header), root_(b.root_), root_value_(std::move(b.root_value_)),
+          max_resident(b.max_resident),
+          loads_(b.loads_), pages(std::move(b.pages)), index(std::move(b.index)) {
+        b.fd = -1;
+    }
+
+    ~lazy_multivector() {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    // open a file written by write_view, keeping at most max_resident
+    // subvectors in memory
+    static lazy_multivector open(const std::string &path, size_t max_resident = 1024) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("lazy_multivector: cannot open " + path + ": " +
+                                     strerror(errno));
+        return lazy_multivector(fd, max_resident);
+    }
+
+    const_cursor root() const { return const_cursor(this, const_cursor::npos, 0); }
+    const_cursor begin() const { return root().begin(); }
+    const_cursor end() const { return root().end(); }
+    const_cursor cbegin() const { return begin(); }
+    const_cursor cend() const { return end(); }
+
+    bool empty() const { return root_.size == 0; }
+    size_t size() const { return header.count - 1; }
+
+    // subvectors in memory, and subvectors read since open
+    size_t resident() const { return pages.size(); }
+    size_t loads() const { return loads_; }
+
+    // the record and value of item i, whose parent is p
+    view_item item(uint64_t p, uint64_t i) const {
+        if (p == const_cursor::npos)
+            return root_;
+        auto &g = page(p);
+        return g.items[i - g.first];
+    }
+    T value(uint64_t p, uint64_t i) const {
+        if (p == const_cursor::npos)
+            return root_value_;
+        auto &g = page(p);
+        return g.values[i - g.first];
+    }
+    uint64_t parent_of(uint64_t p) const { return page(p).parent; }
+
+  private:
+    // the children of one item
+    struct subvector {
+        uint64_t key;    // index of the item
+        uint64_t parent; // index of its parent
+        uint64_t first;  // index of the first child
+        std::vector<view_item> items;
+        std::vector<T> values;
+    };
+    typedef std::list<subvector> page_list;
+
+    lazy_multivector(int fd, size_t max_resident)
+        : fd(fd), max_resident(max_resident ? max_resident : 1), loads_(0) {
+        try {
+            read(&header, sizeof(header), 0);
+            if (memcmp(header.magic, "mvv\1", 4) != 0)
+                throw std::runtime_error("lazy_multivector: not a multivector view");
+            if (header.value_size != view_traits<T>::value_size)
+                throw std::runtime_error("lazy_multivector: value type mismatch");
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+                throw std::runtime_error("lazy_multivector: cannot stat file");
+            if (header.bytes > uint64_t(st.st_size) || header.count == 0 ||
+                header.items > header.values || header.values > header.blob ||
+                header.blob > header.bytes ||
+                header.count > (header.values - header.items) / sizeof(view_item) ||
+                header.count > (header.blob - header.values) / header.value_size)
+                throw std::runtime_error("lazy_multivector: corrupt header");
+            read(&root_, sizeof(root_), header.items);
+            if (root_.parent != const_cursor::npos || !valid(root_, 0))
+                throw std::runtime_error("lazy_multivector: corrupt items");
+            std::vector<T> v;
+            load_values(0, 1, v);
+            root_value_ = std::move(v[0]);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+    void read(void *d, size_t n, uint64_t offset) const {
+        auto p = static_cast<char *>(d);
+        while (n) {
+            auto r = pread(fd, p, n, offset);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                throw std::runtime_error("lazy_multivector: read failed");
+            p += r;
+            n -= r;
+            offset += r;
+        }
+    }
+
+    // the children of item k are in range and follow it, as multivector_view
+    // checks when it is opened
+    bool valid(const view_item &i, uint64_t k) const {
+        auto n = header.count;
+        return i.size <= n && i.first <= n - i.size && (!i.size || i.first > k);
+    }
+
+    void load_values(uint64_t first, size_t n, std::vector<T> &out) const {
+        std::vector<char> values(n * header.value_size), blob;
+        read(values.data(), values.size(), header.values + first * header.value_size);
+        for (size_t k = 0; k < n; ++k)
+            if (!view_traits<T>::valid(values.data(), header.bytes - header.blob, k))
+                throw std::runtime_error("lazy_multivector: corrupt values");
+        auto range = values_type::blob_range(values, n);
+        blob.resize(range.second - range.first);
+        if (!blob.empty())
+            read(blob.data(), blob.size(), header.blob + range.first);
+        values_type::read(values, blob, range.first, n, out);
+    }
+
+    // the subvector holding the children of item p, most recently used first.
+    // Each subvector is checked as it is read, so a corrupt file throws
+    // std::runtime_error rather than reading outside the file or a page.
+    const subvector &page(uint64_t p) const {
+        if (!pages.empty() && pages.front().key == p)
+            return pages.front();
+        auto f = index.find(p);
+        if (f != index.end()) {
+            pages.splice(pages.begin(), pages, f->second);
+            return pages.front();
+        }
+        if (pages.size() >= max_resident) {
+            index.erase(pages.back().key);
+            pages.pop_back();
+        }
+        if (p >= header.count)
+            throw std::runtime_error("lazy_multivector: corrupt items");
+        view_item r;
+        read(&r, sizeof(r), header.items + p * sizeof(view_item));
+        if ((p ? r.parent >= p : r.parent != const_cursor::npos) || !valid(r, p))
+            throw std::runtime_error("lazy_multivector: corrupt items");
+        subvector g{p, r.parent, r.first, std::vector<view_item>(r.size), {}};
+        if (r.size) {
+            read(g.items.data(), r.size * sizeof(view_item),
+                 header.items + r.first * sizeof(view_item));
+            for (size_t k = 0; k < r.size; ++k)
+                if (g.items[k].parent != p || !valid(g.items[k], r.first + k))
+                    throw std::runtime_error("lazy_multivector: corrupt items");
+            load_values(r.first, r.size, g.values);
+        }
+        pages.push_front(std::move(g));
+        index[p] = pages.begin();
+        ++loads_;
+        return pages.front();
+    }
+
+    int fd;
+    view_header header;
+    view_item root_;
+    T root_value_;
+    size_t max_resident;
+    mutable size_t loads_;
+    mutable page_list pages;
+    mutable std::unordered_map<uint64_t, typename page_list::iterator> index;
+};
+
+template <typename T> inline std::string compact_string(const lazy_multivector<T> &tree) {
+    return compact_string(tree.root());
+}
+
+template <typename T> inline std::string to_text(const lazy_multivector<T> &tree) {
+    return to_text(tree.root());
+}
+
+} // namespace wythe
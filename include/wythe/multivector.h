@@ -4,10 +4,24 @@
         Licensed under the MIT License <http://opensource.org/licenses/MIT>.
         Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
 */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <functional>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <span>
 #include <sstream>
+#include <stdexcept>
+#include <string.h>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -22,10 +36,21 @@ template <typename ValueType, bool is_const_iterator> struct linear_cursor_base;
 // forward declare precursor
 template <typename ValueType, bool is_const_cursor> struct precursor_base;
 
+// forward declare multivector and mutation_observer
+template <typename ValueType> struct multivector;
+template <typename ValueType> struct mutation_observer;
+
+// Where a multivector is.  Each tree allocates one and hands it on when it is
+// moved, so cursors that hold it find their tree in constant time after the
+// tree moves.  A null tree marks items that belong to no tree yet.
+template <typename ValueType> struct tree_anchor {
+    multivector<ValueType> *tree;
+};
+
 // Random Access (among siblings)
 template <typename ValueType, bool is_const_cursor>
-struct cursor_base
-    : public std::iterator<std::bidirectional_iterator_tag, ValueType> {
+struct cursor_base {
+    typedef std::random_access_iterator_tag iterator_category;
     typedef bool is_cursor;
     typedef ValueType value_type;
     typedef item<ValueType> item_type;
@@ -56,16 +81,21 @@ struct cursor_base
 
     typedef linear_cursor_base<ValueType, is_const_cursor> linear_type;
 
-    typedef int difference_type;
+    typedef typename std::conditional<is_const_cursor, const multivector<ValueType> *,
+                                      multivector<ValueType> *>::type tree_pointer;
+    typedef const tree_anchor<ValueType> *anchor_pointer;
+
+    typedef std::ptrdiff_t difference_type;
 
     // constructors
-    cursor_base() : v(nullptr), it_(nullptr) {}
-    cursor_base(precursor_reference b) : it_(b.it_) {
+    cursor_base() : v(nullptr), it_(nullptr), anchor_(nullptr) {}
+    cursor_base(precursor_reference b) : it_(b.it_), anchor_(nullptr) {
         v = &b.it_->parent_item()->nodes_;
     }
-    cursor_base(const cursor_base<ValueType, false> &b) : v(b.v), it_(b.it_) {}
-    cursor_base(vec_pointer v, item_pointer it) : v(v), it_{it} {}
-    cursor_base(const linear_type b) : v(b.c.v), it_(b.c.it_) {}
+    cursor_base(const cursor_base<ValueType, false> &b) : v(b.v), it_(b.it_), anchor_(b.anchor_) {}
+    cursor_base(vec_pointer v, item_pointer it, anchor_pointer anchor = nullptr)
+        : v(v), it_{it}, anchor_(anchor) {}
+    cursor_base(const linear_type b) : v(b.c.v), it_(b.c.it_), anchor_(b.c.anchor_) {}
 
     // cursor operations
     reference operator*() const { return it_->value; }
@@ -112,11 +142,13 @@ struct cursor_base
         return *this;
     }
 
-    reference operator[](difference_type i) const { return *(begin() + i); }
+    reference operator[](difference_type i) const { return *(*this + i); }
+    // the value of child i, as c[i] is the value of sibling c + i
+    reference child(difference_type i) const { return *(begin() + i); }
     friend cursor_base operator-(cursor_base x, difference_type i) {
         return x + (-i);
     }
-    friend difference_type operator-(cursor_base &x, cursor_base &y) {
+    friend difference_type operator-(const cursor_base &x, const cursor_base &y) {
         return x.it_ - y.it_;
     }
 
@@ -127,69 +159,187 @@ struct cursor_base
         return x += i;
     }
 
-    friend bool operator<(cursor_base &x, cursor_base &y) { return x - y < 0; }
-    friend bool operator>(cursor_base &x, cursor_base &y) { return y < x; }
-    friend bool operator<=(cursor_base &x, cursor_base &y) { return !(y < x); }
-    friend bool operator>=(cursor_base &x, cursor_base &y) { return !(x < y); }
+    friend bool operator<(const cursor_base &x, const cursor_base &y) { return x.it_ < y.it_; }
+    friend bool operator>(const cursor_base &x, const cursor_base &y) { return y < x; }
+    friend bool operator<=(const cursor_base &x, const cursor_base &y) { return !(y < x); }
+    friend bool operator>=(const cursor_base &x, const cursor_base &y) { return !(x < y); }
 
     // cursor specific operations
     bool empty() const { return it_->empty(); }
 
     cursor_type begin() {
-        return cursor_base(it_->vec_pointer(), it_->begin_ptr());
+        return cursor_base(it_->vec_pointer(), it_->begin_ptr(), anchor_);
     }
     cursor_type begin() const {
-        return cursor_base(it_->vec_pointer(), it_->begin_ptr());
+        return cursor_base(it_->vec_pointer(), it_->begin_ptr(), anchor_);
     }
     cursor_type cbegin() const {
-        return cursor_base(it_->vec_pointer(), it_->begin_ptr());
+        return cursor_base(it_->vec_pointer(), it_->begin_ptr(), anchor_);
     }
     cursor_type end() {
-        return cursor_base(it_->vec_pointer(), it_->end_ptr());
+        return cursor_base(it_->vec_pointer(), it_->end_ptr(), anchor_);
     }
     cursor_type end() const {
-        return cursor_base(it_->vec_pointer(), it_->end_ptr());
+        return cursor_base(it_->vec_pointer(), it_->end_ptr(), anchor_);
     }
     cursor_type cend() const {
-        return cursor_base(it_->vec_pointer(), it_->end_ptr());
+        return cursor_base(it_->vec_pointer(), it_->end_ptr(), anchor_);
     }
 
     size_t size() const { return it_->size(); }
 
+    // mutations are reported to the observers of the tree, if any
     template <class... Args> cursor_base emplace(Args &&... args) {
-        return cursor_base(it_->vec_pointer(),
-                           it_->emplace(std::forward<Args>(args)...));
+        auto t = observed_tree();
+        if (t)
+            grow(t);
+        cursor_base c(it_->vec_pointer(), it_->emplace(std::forward<Args>(args)...), anchor_);
+        if (t)
+            t->notify([&](mutation_observer<ValueType> &o) { o.emplaced(*this); });
+        return c;
     }
 
-    void reserve(size_t n) { it_->nodes_.reserve(n); }
+    void reserve(size_t n) {
+        if (auto t = observed_tree())
+            return reserve(t, n);
+        it_->nodes_.reserve(n);
+    }
 
-    void clear() { it_->nodes_.clear(); }
-    void pop_back() { it_->pop_back(); }
-    void promote_last() { it_->promote_last(); }
+    void clear() {
+        if (auto t = observed_tree())
+            t->notify([&](mutation_observer<ValueType> &o) { o.clearing(*this); });
+        it_->nodes_.clear();
+    }
+    void pop_back() {
+        if (auto t = observed_tree())
+            t->notify([&](mutation_observer<ValueType> &o) { o.popping(*this); });
+        it_->pop_back();
+    }
+    void promote_last() {
+        auto t = observed_tree();
+        if (!t)
+            return it_->promote_last();
+        t->notify([&](mutation_observer<ValueType> &o) { o.promoting(*this); });
+        it_->promote_last();
+        t->notify([&](mutation_observer<ValueType> &o) { o.promoted(*this); });
+    }
+    size_t compact() {
+        auto t = observed_tree();
+        if (!t)
+            return it_->compact();
+        t->notify([&](mutation_observer<ValueType> &o) { o.compacting(*this); });
+        auto r = it_->compact();
+        t->notify([&](mutation_observer<ValueType> &o) { o.compacted(*this); });
+        return r;
+    }
 
     template <class... Args> void emplace_back(Args &&... args) {
+        auto t = observed_tree();
+        if (t)
+            grow(t);
         it_->emplace_back(std::forward<Args>(args)...);
+        if (t)
+            t->notify([&](mutation_observer<ValueType> &o) { o.emplaced(*this); });
+    }
+
+    // replace the value; unlike *c = v, observers see the change
+    template <class V> void assign(V &&v) {
+        auto t = observed_tree();
+        if (!t) {
+            it_->value = std::forward<V>(v);
+            return;
+        }
+        t->notify([&](mutation_observer<ValueType> &o) { o.assigning(*this); });
+        it_->value = std::forward<V>(v);
+        t->notify([&](mutation_observer<ValueType> &o) { o.assigned(*this); });
     }
 
-    bool is_first_child() const { return it_->parent != nullptr; }
+    bool is_first_child() const { return it_->is_first_child(); }
 
     cursor_base parent() const {
-        return cursor_base(&it_->parent_item()->parent_item()->nodes_,
-                           it_->parent_item());
+        auto p = it_->parent_item();
+        return cursor_base(p->is_root() ? nullptr : &p->parent_item()->nodes_, p, anchor_);
     }
     bool is_root() const { return it_->is_root(); }
 
+    // The multivector that owns the cursor's root, else nullptr.  Constant
+    // time for cursors derived from root(), otherwise O(depth).
+    tree_pointer tree() const {
+        if (anchor_)
+            return anchor_->tree;
+        auto r = it_;
+        while (r && !r->is_root())
+            r = r->parent_item();
+        return r ? r->owner() : nullptr;
+    }
+
     friend struct cursor_base<ValueType, false>;
 
     vec_pointer v;
     item_pointer it_;
+    anchor_pointer anchor_; // the tree's anchor, or nullptr if not known
+
+  private:
+    // The tree if it is observed, else nullptr.  A cursor that does not know
+    // its anchor only looks for its tree while some multivector<ValueType> is
+    // observed.
+    multivector<ValueType> *observed_tree() const {
+        multivector<ValueType> *t;
+        if (anchor_)
+            t = anchor_->tree;
+        else if (!multivector<ValueType>::observed_trees.load(std::memory_order_relaxed))
+            return nullptr;
+        else
+            t = const_cast<multivector<ValueType> *>(tree());
+        return t && t->observed() ? t : nullptr;
+    }
+
+    // when observed, make room for one more child as a separate, reported step,
+    // so observers holding item addresses can follow the children
+    void grow(multivector<ValueType> *t) {
+        auto &n = it_->nodes_;
+        if (n.size() == n.capacity())
+            reserve(t, std::max<size_t>(1, 2 * n.size()));
+    }
+
+    // make room for size children of an observed tree, reporting the move
+    void reserve(multivector<ValueType> *t, size_t size) {
+        auto &n = it_->nodes_;
+        if (size <= n.capacity())
+            return;
+        if (n.empty())
+            return n.reserve(size);
+        t->notify([&](mutation_observer<ValueType> &o) { o.relocating(*this); });
+        n.reserve(size);
+        t->notify([&](mutation_observer<ValueType> &o) { o.relocated(*this); });
+    }
+};
+
+// Receives the mutations made through the cursors of a multivector, see
+// multivector::observe().  Removals are reported before, additions after.
+template <typename ValueType> struct mutation_observer {
+    typedef cursor_base<ValueType, false> cursor;
+
+    virtual ~mutation_observer() {}
+    virtual void emplaced(cursor /* parent */) {} // a child was added at the end
+    virtual void popping(cursor /* parent */) {}  // the last child will be removed
+    virtual void clearing(cursor /* parent */) {} // the children will be removed
+    virtual void promoting(cursor /* parent */) {} // promote_last will be applied
+    virtual void promoted(cursor /* parent */) {}  // promote_last was applied
+    virtual void relocating(cursor /* parent */) {} // the children will move
+    virtual void relocated(cursor /* parent */) {}  // the children have moved
+    virtual void compacting(cursor /* parent */) {} // the descendants will move
+    virtual void compacted(cursor /* parent */) {}  // the descendants have moved
+    virtual void assigning(cursor /* c */) {}     // the value will be replaced
+    virtual void assigned(cursor /* c */) {}      // the value was replaced
+    virtual void replaced(multivector<ValueType> &) {} // the whole tree was assigned
 };
 
 // Forward iterator
 // operator++ just goes up and to the left until the root.
 template <typename ValueType, bool is_const_cursor>
-struct precursor_base
-    : public std::iterator<std::forward_iterator_tag, ValueType> {
+struct precursor_base {
+    typedef std::forward_iterator_tag iterator_category;
     typedef ValueType value_type;
     typedef item<ValueType> item_type;
 
@@ -213,7 +363,7 @@ struct precursor_base
     typedef precursor_type *precursor_pointer;
     typedef const precursor_type &const_precursor_reference;
 
-    typedef int difference_type;
+    typedef std::ptrdiff_t difference_type;
 
     // constructors
     precursor_base() {}
@@ -229,7 +379,7 @@ struct precursor_base
     item_pointer item_ptr() const { return &(*it_); }
 
     precursor_reference operator++() {
-        if (it_->parent == 0)
+        if (!it_->is_first_child())
             --it_;
         else
             it_ = it_->parent;
@@ -264,8 +414,10 @@ struct precursor_base
 };
 
 template <typename ValueType, bool is_const_cursor>
-struct linear_cursor_base
-    : public std::iterator<std::forward_iterator_tag, ValueType> {
+struct linear_cursor_base {
+    typedef std::forward_iterator_tag iterator_category;
+    typedef ValueType value_type;
+    typedef std::ptrdiff_t difference_type;
     typedef linear_cursor_base linear_type;
     typedef linear_type &linear_reference;
     typedef linear_type *linear_pointer;
@@ -287,6 +439,10 @@ struct linear_cursor_base
 
     bool operator!=(const_linear_reference b) const { return !operator==(b); }
 
+    // a cursor converts to either, so compare with one directly
+    bool operator==(const cursor_type &b) const { return c == b; }
+    bool operator!=(const cursor_type &b) const { return !operator==(b); }
+
     linear_reference operator++() {
         if (!c.empty()) {
             parents.push_back(c);
@@ -335,24 +491,20 @@ template <typename ValueType> struct item {
     typedef const item *const_item_pointer;
 
     typedef size_t size_type;
-    typedef int difference_type;
+    typedef std::ptrdiff_t difference_type;
 
-    //! Default constructor
-    item() : parent{(item *)(-1)} {}
+    //! Default constructor, value initializes the value
+    item() : parent{(item *)(-1)}, value() {}
 
-    //! Copy constructor
-    item(const item &b) : parent(0) {
-        parent = b.parent;
-        value = b.value;
-        nodes_ = b.nodes_;
+    //! Copy constructor, each value is copy constructed exactly once
+    item(const item &b) : parent(b.parent), value(b.value), nodes_(b.nodes_) {
         if (!nodes_.empty())
             nodes_[0].parent = this;
     }
 
-    item(item &&b) noexcept : parent(0) {
-        parent = b.parent;
-        value = std::move(b.value);
-        nodes_ = std::move(b.nodes_);
+    item(item &&b) noexcept
+        : parent(b.parent), value(std::move(b.value)),
+          nodes_(std::move(b.nodes_)) {
         if (!nodes_.empty())
             nodes_[0].parent = this;
     }
@@ -382,7 +534,7 @@ template <typename ValueType> struct item {
     }
 
     item &operator=(value_type b) {
-        value = b;
+        value = std::move(b);
         return *this;
     }
 
@@ -420,11 +572,11 @@ template <typename ValueType> struct item {
         return item_count(&(nodes_[0]), &nodes_.back() + 1);
     }
 
-    item_reference operator[](int index) { return nodes_[index]; }
-    const_item_reference operator[](int index) const { return nodes_[index]; }
+    item_reference operator[](size_type index) { return nodes_[index]; }
+    const_item_reference operator[](size_type index) const { return nodes_[index]; }
 
     template <class... Args> void emplace_back(Args &&... args) {
-        nodes_.emplace_back(nullptr, std::forward<Args>(args)...);
+        nodes_.emplace_back(sibling_tag(nodes_.size()), std::forward<Args>(args)...);
         nodes_[0].parent = this;
     }
 
@@ -436,13 +588,49 @@ template <typename ValueType> struct item {
     operator reference() { return value; }
     operator const_reference() const { return value; }
 
-    bool is_root() const { return parent == (item *)(-1); }
+    //! The parent of a root is -1, or the address of the multivector that owns
+    //! it tagged in bit 1, which no item address or sibling index has set alone.
+    bool is_root() const {
+        return parent == (item *)(-1) || (reinterpret_cast<uintptr_t>(parent) & 3) == 2;
+    }
+
+    static item_pointer root_tag(const multivector<value_type> *tree) {
+        return reinterpret_cast<item_pointer>(reinterpret_cast<uintptr_t>(tree) | 2);
+    }
+
+    //! the multivector that owns this root, or nullptr
+    multivector<value_type> *owner() const {
+        auto p = reinterpret_cast<uintptr_t>(parent);
+        return (p & 3) == 2 ? reinterpret_cast<multivector<value_type> *>(p & ~uintptr_t(3))
+                            : nullptr;
+    }
+
+    //! The parent of a first child points to its parent item.  The parent of
+    //! any other child is its index among its siblings, tagged in the low bit,
+    //! so the parent item is found in constant time.
+    static item_pointer sibling_tag(size_t index) {
+        return reinterpret_cast<item_pointer>((uintptr_t(index) << 1) | 1);
+    }
+
+    bool is_first_child() const {
+        return !(reinterpret_cast<uintptr_t>(parent) & 1) || is_root();
+    }
+
+    //! index among siblings
+    size_t sibling_index() const {
+        return is_first_child() ? 0 : reinterpret_cast<uintptr_t>(parent) >> 1;
+    }
 
     item_pointer parent_item() const {
-        auto i = this;
-        while (!i->parent)
-            --i;
-        return i->parent;
+        return is_first_child() ? parent : (this - sibling_index())->parent;
+    }
+
+    //! set the parent of each child
+    void relink(size_t first = 0) {
+        for (auto k = first; k < nodes_.size(); ++k)
+            nodes_[k].parent = sibling_tag(k);
+        if (!nodes_.empty())
+            nodes_[0].parent = this;
     }
 
     // promote the children of the last item
@@ -451,26 +639,55 @@ template <typename ValueType> struct item {
         if (nodes_.empty())
             return;
         auto last = std::move(nodes_.back());
-        last[0].parent = 0; // set its parent pointer to 0
-        nodes_.resize(nodes_.size() - 1);
+        nodes_.pop_back();
 
         if (last.empty())
             return;
         // now move its contents
+        auto first = nodes_.size();
         std::move(last.nodes_.begin(), last.nodes_.end(),
                   std::back_inserter(nodes_));
+        relink(first); // and nodes_[0], in case nodes_ was reallocated
+    }
+
+    //! Move all descendants into exactly sized subvectors, allocated in
+    //! depth-first order for locality.  Return the number of bytes reclaimed.
+    size_t compact() {
+        size_t reclaimed = (nodes_.capacity() - nodes_.size()) * sizeof(item);
+        if (nodes_.empty()) {
+            vector_type().swap(nodes_);
+            return reclaimed;
+        }
+        vector_type fresh;
+        fresh.reserve(nodes_.size());
+        for (auto &i : nodes_)
+            fresh.emplace_back(std::move(i));
+        nodes_ = std::move(fresh); // releases the old subvector
+        nodes_[0].parent = this;
+        for (auto &i : nodes_)
+            reclaimed += i.compact();
+        return reclaimed;
+    }
 
-        nodes_[0].parent = this; // in case nodes_ was reallocated
+    //! Replace the children with [first, last), moved into an exactly sized
+    //! subvector.
+    template <typename Iterator> void adopt(Iterator first, Iterator last) {
+        vector_type fresh;
+        fresh.reserve(std::distance(first, last));
+        for (; first != last; ++first)
+            fresh.emplace_back(std::move(*first));
+        nodes_ = std::move(fresh);
+        relink();
     }
 
     void insert_parent() {
         // detach all the children;
-        auto t = nodes_;
+        auto t = std::move(nodes_);
         nodes_.clear();
-        nodes_.emplace_back();
-        nodes_[0].parent = this;
-        nodes_[0].nodes_ = t;
-        nodes_[0].nodes_[0].parent = &nodes_[0];
+        nodes_.emplace_back(this);
+        nodes_[0].nodes_ = std::move(t);
+        if (!nodes_[0].nodes_.empty())
+            nodes_[0].nodes_[0].parent = &nodes_[0];
     }
 
     const_vector_pointer vec_pointer() const { return &nodes_; }
@@ -525,6 +742,10 @@ template <typename T> struct init_list_type {
     T d;
 };
 
+// tag for constructing a multivector's root value in place
+struct root_value_t {};
+constexpr root_value_t root_value{};
+
 template <typename value_type> struct multivector {
     typedef bool is_multivector;
     typedef item<value_type> item_type;
@@ -542,45 +763,68 @@ template <typename value_type> struct multivector {
 
     // Semiregular
     // default constructable: multivector a;
-    multivector() {
-        root_.value = value_type();
-        root_.parent = (item<value_type> *)(-1);
-    }
+    multivector() : root_(root_parent()), anchor_(new_anchor()) {}
 
     // copy constructable: multivector a = b;
-    multivector(const multivector &b) : root_(b.root_){};
+    multivector(const multivector &b) : root_(b.root_), anchor_(new_anchor()) {
+        root_.parent = root_parent();
+    }
 
-    multivector(multivector &&b) noexcept { root_ = std::move(b.root_); };
+    // the anchor moves with the items, a moved-from tree makes a new one when
+    // it is next used
+    multivector(multivector &&b) noexcept
+        : root_(std::move(b.root_)), anchor_(std::move(b.anchor_)) {
+        root_.parent = root_parent();
+        if (anchor_)
+            anchor_->tree = this;
+    }
+
+    ~multivector() {
+        if (observed())
+            --observed_trees;
+    }
+
+    // construct the root value in place, for value types that are not
+    // default constructible: multivector a(wythe::root_value, args...);
+    template <class... Args>
+    explicit multivector(root_value_t, Args &&... args)
+        : root_(root_parent(), std::forward<Args>(args)...), anchor_(new_anchor()) {}
 
     // Conversions
-    explicit multivector(cursor a) : root_(a.item_ref()) {
-        root_.value = value_type(); // weird
-        root_.parent = (item<value_type> *)(-1);
+    explicit multivector(cursor a) : root_(root_parent()), anchor_(new_anchor()) {
+        root_.nodes_ = a.item_ref().nodes_;
+        if (!root_.empty())
+            root_.nodes_[0].parent = &root_;
     }
 
     // initialization list
-    multivector(std::initializer_list<init_list_type<value_type>> l) {
-        root_.value = value_type();
-        root_.parent = (item<value_type> *)(-1);
+    multivector(std::initializer_list<init_list_type<value_type>> l)
+        : root_(root_parent()), anchor_(new_anchor()) {
         for (const auto &e : l)
             e.add(root());
     }
 
-    multivector(std::initializer_list<init_list_type<const char *>> l) {
-        root_.value = value_type();
-        root_.parent = (item<value_type> *)(-1);
+    multivector(std::initializer_list<init_list_type<const char *>> l)
+        : root_(root_parent()), anchor_(new_anchor()) {
         for (const auto &e : l)
             e.add(root());
     }
 
-    // assignment
+    // assignment, observers stay with the tree they observe
     multivector &operator=(const multivector &b) {
         root_ = b.root_;
+        notify([&](mutation_observer<value_type> &o) { o.replaced(*this); });
         return *this;
     }
 
     multivector &operator=(multivector &&b) noexcept {
         root_ = std::move(b.root_);
+        std::swap(anchor_, b.anchor_);
+        if (anchor_)
+            anchor_->tree = this;
+        if (b.anchor_)
+            b.anchor_->tree = &b;
+        notify([&](mutation_observer<value_type> &o) { o.replaced(*this); });
         return *this;
     }
 
@@ -610,20 +854,48 @@ template <typename value_type> struct multivector {
         return !(a < b);
     }
 
-    item_reference operator[](int index) { return root()[index]; }
-    const_item_reference operator[](int index) const { return root()[index]; }
+    item_reference operator[](int index) { return root_[index]; }
+    const_item_reference operator[](int index) const { return root_[index]; }
 
     template <class... Args> void emplace_back(Args &&... args) {
         root().emplace_back(std::forward<Args>(args)...);
     }
 
     //! clear
-    void clear() { root_.clear(); }
+    void clear() { root().clear(); }
     void pop_back() { root().pop_back(); }
 
+    //! shrink and relocate the whole tree, return the bytes reclaimed
+    size_t compact() { return root().compact(); }
+
+    //! Report the mutations made through cursors of this tree to o, which
+    //! must outlive the observation.  Writes through *cursor are not seen.
+    void observe(mutation_observer<value_type> *o) {
+        if (!observed())
+            ++observed_trees;
+        observers_.push_back(o);
+    }
+    void unobserve(mutation_observer<value_type> *o) {
+        if (!observed())
+            return;
+        observers_.erase(std::remove(observers_.begin(), observers_.end(), o), observers_.end());
+        if (!observed())
+            --observed_trees;
+    }
+    bool observed() const { return !observers_.empty(); }
+
+    template <typename F> void notify(F f) {
+        for (auto o : observers_)
+            f(*o);
+    }
+
     bool empty() const { return root_.empty(); }
-    cursor root() { return cursor(nullptr, &root_); }
-    const_cursor root() const { return const_cursor(nullptr, &root_); }
+    cursor root() {
+        if (!anchor_)
+            anchor_.reset(new_anchor());
+        return cursor(nullptr, &root_, anchor_.get());
+    }
+    const_cursor root() const { return const_cursor(nullptr, &root_, anchor_.get()); }
 
     size_t size() const { return root_.item_count(); }
     cursor begin() { return root().begin(); }
@@ -635,6 +907,19 @@ template <typename value_type> struct multivector {
     const_cursor cend() const { return root().end(); }
 
     item<value_type> root_;
+
+    // the number of observed multivector<value_type>, so cursors that do not
+    // know their tree's anchor skip looking for the tree
+    static inline std::atomic<size_t> observed_trees{0};
+
+  private:
+    // the root's parent names the tree, so cursors can find it after a move
+    item_pointer root_parent() const { return item_type::root_tag(this); }
+    tree_anchor<value_type> *new_anchor() { return new tree_anchor<value_type>{this}; }
+
+    std::unique_ptr<tree_anchor<value_type>> anchor_;
+
+    std::vector<mutation_observer<value_type> *> observers_;
 };
 
 template <typename T>
@@ -650,6 +935,68 @@ inline std::ostringstream &operator<<(std::ostringstream &ss,
     return ss;
 }
 
+// Resolves fixed paths to cursors, caching the results in a direct mapped
+// table of slots.  Any structural change to the tree, reported to the cache as
+// a mutation_observer, invalidates every entry.
+template <typename T> struct path_cache : mutation_observer<T> {
+    typedef typename multivector<T>::cursor cursor;
+
+    explicit path_cache(multivector<T> &tree, size_t slots = 256)
+        : tree(tree), slots(slots ? slots : 1), generation(1), hits_(0), misses_(0) {
+        tree.observe(this);
+    }
+    ~path_cache() { tree.unobserve(this); }
+
+    path_cache(const path_cache &) = delete;
+    path_cache &operator=(const path_cache &) = delete;
+
+    // at_path(tree.root(), path), throws std::out_of_range
+    cursor at(std::span<const size_t> path) {
+        uint64_t h = 14695981039346656037ull;
+        for (auto i : path)
+            h = (h ^ i) * 1099511628211ull;
+        auto &s = slots[(h ^ (h >> 32)) % slots.size()];
+        if (s.generation == generation &&
+            std::equal(path.begin(), path.end(), s.path.begin(), s.path.end())) {
+            ++hits_;
+            return s.c;
+        }
+        ++misses_;
+        auto c = at_path(tree.root(), path);
+        s.path.assign(path.begin(), path.end());
+        s.c = c;
+        s.generation = generation;
+        return c;
+    }
+    cursor at(std::initializer_list<size_t> path) {
+        return at(std::span<const size_t>(path.begin(), path.size()));
+    }
+
+    void clear() { ++generation; }
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+    void emplaced(cursor) override { clear(); }
+    void popping(cursor) override { clear(); }
+    void clearing(cursor) override { clear(); }
+    void promoting(cursor) override { clear(); }
+    void compacting(cursor) override { clear(); }
+    void replaced(multivector<T> &) override { clear(); }
+
+  private:
+    struct slot {
+        uint64_t generation = 0;
+        std::vector<size_t> path;
+        cursor c;
+    };
+
+    multivector<T> &tree;
+    std::vector<slot> slots;
+    uint64_t generation;
+    size_t hits_, misses_;
+};
+
 // multivector algorithms
 
 // replace all occurances of a with b in string x.  Return reference to x.
@@ -663,7 +1010,6 @@ inline std::string &replace(std::string &x, std::string const &a,
     return x;
 }
 
-#include <string.h>
 inline const char *spaces(int spaces) {
     static const char s[] =
         "                                                           "
@@ -702,18 +1048,84 @@ template <typename S> inline S &normalize(S &v) {
     return v;
 }
 
-// return the root cursor of a multivector given a cursor
+namespace detail {
+// the tree anchor of a multivector cursor, nullptr for other cursors
+template <typename Cursor> auto anchor_of(const Cursor &c, int) -> decltype(c.anchor_) {
+    return c.anchor_;
+}
+template <typename Cursor> const void *anchor_of(const Cursor &, long) { return nullptr; }
+} // namespace detail
+
+// Return the root cursor of a multivector given a cursor.  Constant time for
+// cursors derived from root(), otherwise O(depth).
 template <typename Cursor> Cursor get_root(Cursor start) {
-#if 1
+    if constexpr (requires { start.anchor_; })
+        if (start.anchor_ && start.anchor_->tree)
+            return Cursor(nullptr, &start.anchor_->tree->root_, start.anchor_);
     while (!start.is_root())
         start = start.parent();
     return start;
-#else
-    auto r = typename Cursor::precursor_type(start);
-    while (!r.is_root())
-        ++r;
-    return r;
-#endif
+}
+
+// true if a and b are cursors into the same multivector
+template <typename Cursor1, typename Cursor2> bool same_tree(Cursor1 a, Cursor2 b) {
+    auto x = detail::anchor_of(a, 0);
+    auto y = detail::anchor_of(b, 0);
+    if (x && y)
+        return (const void *)x == (const void *)y;
+    return get_root(a).item_ptr() == get_root(b).item_ptr();
+}
+
+// the cursor at a path of child indices below parent, for example
+// at_path(tree.root(), {5, 7, 3}) is ((tree.begin() + 5).begin() + 7).begin() + 3.
+// Throws std::out_of_range if an index is out of range.
+template <typename Cursor> Cursor at_path(Cursor parent, std::span<const size_t> path) {
+    for (auto i : path) {
+        if (i >= parent.size())
+            throw std::out_of_range("at_path: index out of range");
+        parent = parent.begin() + typename Cursor::difference_type(i);
+    }
+    return parent;
+}
+
+template <typename Cursor>
+Cursor at_path(Cursor parent, std::initializer_list<size_t> path) {
+    return at_path(parent, std::span<const size_t>(path.begin(), path.size()));
+}
+
+// navigate(tree.root(), 5, 7, 3) is at_path(tree.root(), {5, 7, 3})
+template <typename Cursor, typename... Indices>
+Cursor navigate(Cursor parent, Indices... indices) {
+    const std::array<size_t, sizeof...(Indices)> path{size_t(indices)...};
+    return at_path(parent, std::span<const size_t>(path));
+}
+
+// the child indices from the root to c, in O(depth)
+template <typename Cursor> std::vector<size_t> path_of(Cursor c) {
+    std::vector<size_t> path;
+    for (; !c.is_root(); c = c.parent())
+        path.push_back(c.item_ref().sibling_index());
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+// the first child of parent whose proj(value) is not less than key, for
+// children sorted by comp on proj(value).  A binary search, O(log n).
+template <typename Cursor, typename Key, typename Compare = std::ranges::less,
+          typename Proj = std::identity>
+Cursor lower_bound_child(Cursor parent, const Key &key, Compare comp = {}, Proj proj = {}) {
+    return std::ranges::lower_bound(parent.begin(), parent.end(), key, comp, proj);
+}
+
+// the first child of parent whose proj(value) is equivalent to key, or
+// parent.end(), for children sorted as for lower_bound_child.
+template <typename Cursor, typename Key, typename Compare = std::ranges::less,
+          typename Proj = std::identity>
+Cursor find_child_sorted(Cursor parent, const Key &key, Compare comp = {}, Proj proj = {}) {
+    auto c = lower_bound_child(parent, key, comp, proj);
+    if (c != parent.end() && !std::invoke(comp, key, std::invoke(proj, *c)))
+        return c;
+    return parent.end();
 }
 
 // return the previous cursor, either a sibling or parent
@@ -743,69 +1155,230 @@ void recurse(Cursor parent, ActionDown action_down, ActionUp action_up,
     }
 }
 
-// verify the internal integrity of the multivector
+// verify the internal integrity of the multivector, throw std::runtime_error
 template <typename T> void verify(T parent) {
     recurse(parent, [](T self) {
         size_t count = 0;
         if (self.empty() && self.size() != 0)
-            std::runtime_error("empty cursor has non-zero size");
+            throw std::runtime_error("empty cursor has non-zero size");
         if (!self.empty()) {
-            if (self.begin().it_->parent == 0)
-                std::runtime_error("parent set to 0");
+            if (!self.begin().item_ref().is_first_child())
+                throw std::runtime_error("first child has a sibling index");
             if (self.begin().it_->parent != &(self.item_ref())) {
                 std::ostringstream os;
                 os << "incorrect first child " << self.begin().it_->parent
                    << ", " << &(*self);
-                std::runtime_error(os.str());
+                throw std::runtime_error(os.str());
             }
 
             ++count;
             for (auto i = self.begin() + 1; i != self.end(); ++i, ++count) {
-                if (i.item_ref().parent != 0)
-                    std::runtime_error("non-first child of self is not zero");
+                if (i.item_ref().sibling_index() != count)
+                    throw std::runtime_error("incorrect sibling index");
             }
 
             if (count != self.size())
-                std::runtime_error("incorrect size");
+                throw std::runtime_error("incorrect size");
         }
-        get_root(self); // make sure this doesn't seg fault
     });
 }
 
 template <typename T> inline void verify(const multivector<T> &tree) {
-    if (tree.root().item_ref().parent != (item<T> *)(-1)) {
+    if (tree.root().tree() != &tree) {
         std::ostringstream os;
         os << "root parent is not valid: " << tree.root().item_ref().parent;
-        std::runtime_error(os.str());
+        throw std::runtime_error(os.str());
     }
     verify(tree.root());
 }
 
-// convert to a compact string
-template <typename Cursor> inline std::string compact_string(Cursor parent) {
-    std::ostringstream ss;
-    recurse(parent,
-            [&](Cursor self, int) {
-                ss << *self;
-                if (!self.empty())
-                    ss << " {";
-                else {
-                    auto p = self.parent();
-                    if (self != --p.end())
-                        ss << ' ';
-                }
-            },
+// How values are written to and read from text.  Arithmetic values use
+// std::to_chars and std::from_chars, strings are copied as is and everything
+// else uses operator<< and operator>>.  Buffer is anything with
+// push_back(char) and append(const char *, size_t), such as std::string.
+template <typename T, typename Enable = void> struct text_codec {
+    template <typename Buffer> static void format(Buffer &buf, const T &v) {
+        static thread_local std::ostringstream os;
+        os.str(std::string());
+        os << v;
+        auto s = os.str();
+        buf.append(s.data(), s.size());
+    }
+    static T parse(std::string_view s) {
+        std::istringstream is{std::string(s)};
+        T v;
+        if (!(is >> v))
+            throw std::runtime_error("cannot parse \"" + std::string(s) + "\"");
+        return v;
+    }
+};
 
-            [&](Cursor self, int) {
-                if (!self.empty())
-                    ss << "} ";
-            });
+template <typename T>
+struct text_codec<
+    T, typename std::enable_if<std::is_arithmetic<T>::value &&
+                               !std::is_same<T, bool>::value &&
+                               !std::is_same<T, char>::value &&
+                               !std::is_same<T, signed char>::value &&
+                               !std::is_same<T, unsigned char>::value>::type> {
+    // floating point values are written in their shortest exact form
+    template <typename Buffer> static void format(Buffer &buf, T v) {
+        char s[64];
+        auto r = std::to_chars(s, s + sizeof(s), v);
+        buf.append(s, r.ptr - s);
+    }
+    static T parse(std::string_view s) {
+        T v;
+        auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+        if (r.ec != std::errc() || r.ptr != s.data() + s.size())
+            throw std::runtime_error("cannot parse \"" + std::string(s) + "\"");
+        return v;
+    }
+};
 
-    // convert all "} }" patterns to "}}"
-    auto x = ss.str();
-    replace(x, " }", "}");
-    normalize(x);
-    return x;
+template <> struct text_codec<std::string> {
+    template <typename Buffer> static void format(Buffer &buf, std::string_view v) {
+        buf.append(v.data(), v.size());
+    }
+    static std::string parse(std::string_view s) { return std::string(s); }
+};
+
+// adapts an output iterator to the Buffer interface of text_codec
+template <typename OutputIt> struct iterator_buffer {
+    explicit iterator_buffer(OutputIt out) : out(out) {}
+    void push_back(char c) { *out++ = c; }
+    void append(const char *p, size_t n) { out = std::copy(p, p + n, out); }
+    OutputIt out;
+};
+
+namespace detail {
+// the parent pointer of a multivector item, for debug text
+template <typename Cursor>
+auto debug_parent(const Cursor &c, int) -> decltype((const void *)c.item_ref().parent) {
+    auto &i = c.item_ref();
+    if (i.is_root())
+        return (const void *)(-1);
+    return i.is_first_child() ? i.parent : nullptr;
+}
+template <typename Cursor> const void *debug_parent(const Cursor &, long) { return nullptr; }
+
+template <typename Buffer> void format_pointer(Buffer &buf, const void *p) {
+    if (!p) {
+        buf.push_back('0');
+        return;
+    }
+    char s[2 + 2 * sizeof(p)] = {'0', 'x'};
+    auto r = std::to_chars(s + 2, s + sizeof(s), reinterpret_cast<uintptr_t>(p), 16);
+    buf.append(s, r.ptr - s);
+}
+} // namespace detail
+
+// Writes the text of a tree one item at a time in a single pass, so it can
+// be produced incrementally.  The compact format is "1 2 {3 4 {5}} 6".  The
+// table format is one item per line indented by two spaces per level.  The
+// debug format is the table format plus the parent pointer of each item,
+// starting with the parent itself.
+template <typename Cursor> struct text_writer {
+    typedef typename Cursor::value_type value_type;
+    enum format_type { compact, table, debug };
+
+    text_writer(Cursor parent, format_type format)
+        : format(format), start(true), head(format == debug), parent(parent) {
+        if (!parent.empty())
+            stack.push_back(frame{parent.begin(), parent.end()});
+    }
+
+    // append the text of the next item, return false when there are no more
+    template <typename Buffer> bool next(Buffer &buf) {
+        if (head) {
+            head = false;
+            text_codec<value_type>::format(buf, *parent);
+            buf.push_back(' ');
+            detail::format_pointer(buf, detail::debug_parent(parent, 0));
+            buf.push_back('\n');
+            return true;
+        }
+        while (!stack.empty() && stack.back().first == stack.back().last) {
+            stack.pop_back();
+            if (format == compact && !stack.empty())
+                buf.push_back('}');
+            start = false;
+        }
+        if (stack.empty())
+            return false;
+        auto c = stack.back().first++;
+        if (format == compact) {
+            if (!start)
+                buf.push_back(' ');
+            text_codec<value_type>::format(buf, *c);
+            start = !c.empty();
+            if (start)
+                buf.append(" {", 2);
+        } else {
+            auto indent = spaces(int(stack.size() - 1) * 2);
+            buf.append(indent, strlen(indent));
+            text_codec<value_type>::format(buf, *c);
+            if (format == debug) {
+                buf.push_back(' ');
+                detail::format_pointer(buf, detail::debug_parent(c, 0));
+            }
+            buf.push_back('\n');
+        }
+        if (!c.empty())
+            stack.push_back(frame{c.begin(), c.end()});
+        return true;
+    }
+
+    bool done() const { return !head && stack.empty(); }
+
+  private:
+    struct frame {
+        Cursor first;
+        Cursor last;
+    };
+    std::vector<frame> stack;
+    format_type format;
+    bool start; // at the start of a subvector
+    bool head;  // the debug line of the parent is next
+    Cursor parent;
+};
+
+// append the compact string representation to buf
+template <typename Cursor> inline void write_compact(Cursor parent, std::string &buf) {
+    text_writer<Cursor> w(parent, text_writer<Cursor>::compact);
+    while (w.next(buf))
+        ;
+}
+
+template <typename Cursor, typename OutputIt>
+inline OutputIt write_compact(Cursor parent, OutputIt out) {
+    iterator_buffer<OutputIt> buf(out);
+    text_writer<Cursor> w(parent, text_writer<Cursor>::compact);
+    while (w.next(buf))
+        ;
+    return buf.out;
+}
+
+// append the table representation to buf
+template <typename Cursor> inline void write_text(Cursor parent, std::string &buf) {
+    text_writer<Cursor> w(parent, text_writer<Cursor>::table);
+    while (w.next(buf))
+        ;
+}
+
+template <typename Cursor, typename OutputIt>
+inline OutputIt write_text(Cursor parent, OutputIt out) {
+    iterator_buffer<OutputIt> buf(out);
+    text_writer<Cursor> w(parent, text_writer<Cursor>::table);
+    while (w.next(buf))
+        ;
+    return buf.out;
+}
+
+// convert to a compact string
+template <typename Cursor> inline std::string compact_string(Cursor parent) {
+    std::string s;
+    write_compact(parent, s);
+    return s;
 }
 
 template <typename T>
@@ -815,37 +1388,186 @@ inline std::string compact_string(const multivector<T> &tree) {
 
 // convert to a table string
 template <typename Cursor> inline std::string to_text(Cursor parent) {
-    std::ostringstream ss;
-    recurse(parent,
-            [&](Cursor self, int level) {
-                ss << spaces(level * 2) << *self << '\n';
-            },
-
-            [&](Cursor, int) {} // nothing to do on the way up
-    );
-    return ss.str();
+    std::string s;
+    write_text(parent, s);
+    return s;
 }
 
 template <typename T> inline std::string to_text(const multivector<T> &tree) {
     return to_text(tree.root());
 }
 
+// Builds a multivector from a depth-first sequence of events:
+//
+//     b.value(1); b.start_children(); b.value(2); b.value(3); b.end_children();
+//
+// builds "1 {2 3}".  Finished items wait in one pending vector, and when
+// end_children() closes a subvector its items are moved into an exactly
+// sized subvector of their parent, so the finished tree has no slack.
+template <typename T> struct tree_builder {
+    typedef item<T> item_type;
+
+    tree_builder() : after_value_(false) {}
+
+    // add an item whose value is constructed from args
+    template <class... Args> void value(Args &&... args) {
+        pending_.emplace_back(nullptr, std::forward<Args>(args)...);
+        after_value_ = true;
+    }
+
+    // the following values are children of the last value
+    void start_children() {
+        if (!after_value_)
+            throw std::logic_error("tree_builder: start_children must follow a value");
+        levels_.push_back(pending_.size());
+        after_value_ = false;
+    }
+
+    void end_children() {
+        if (levels_.empty())
+            throw std::logic_error("tree_builder: end_children without start_children");
+        auto first = levels_.back();
+        levels_.pop_back();
+        pending_[first - 1].adopt(pending_.begin() + first, pending_.end());
+        pending_.erase(pending_.begin() + first, pending_.end());
+        after_value_ = false;
+    }
+
+    bool can_start_children() const { return after_value_; }
+
+    // number of open start_children
+    size_t depth() const { return levels_.size(); }
+
+    // return the tree, the builder can then be reused
+    multivector<T> finish() {
+        if (!levels_.empty())
+            throw std::logic_error("tree_builder: missing end_children");
+        multivector<T> tree;
+        tree.root_.adopt(pending_.begin(), pending_.end());
+        pending_.clear();
+        after_value_ = false;
+        return tree;
+    }
+
+  private:
+    std::vector<item_type> pending_; // items waiting for a parent
+    std::vector<size_t> levels_;     // where each open subvector starts
+    bool after_value_;
+};
+
+// Incremental parser for the compact_string format.  Text is fed in chunks
+// of any size; a value may span chunks.  It is a single pass without
+// backtracking that drives a tree_builder, so each subvector is allocated
+// once at its exact size.  Values are delimited by white space and braces.
+template <typename T> struct compact_parser {
+    compact_parser() : offset_(0) {}
+
+    void feed(std::string_view s) {
+        size_t i = 0;
+        if (!partial_.empty()) { // finish the value from the last chunk
+            while (i < s.size() && !is_delimiter(s[i]))
+                ++i;
+            partial_.append(s.data(), i);
+            if (i == s.size()) {
+                offset_ += i;
+                return;
+            }
+            value(partial_);
+            partial_.clear();
+        }
+        while (i < s.size()) {
+            char ch = s[i];
+            if (ch == '{')
+                open(offset_ + i);
+            else if (ch == '}')
+                close(offset_ + i);
+            else if (!is_space(ch)) {
+                auto j = i;
+                while (j < s.size() && !is_delimiter(s[j]))
+                    ++j;
+                if (j == s.size()) { // continued in the next chunk
+                    partial_.assign(s.data() + i, j - i);
+                    break;
+                }
+                value(s.substr(i, j - i));
+                i = j;
+                continue;
+            }
+            ++i;
+        }
+        offset_ += s.size();
+    }
+
+    // finish parsing and return the tree
+    multivector<T> finish() {
+        if (!partial_.empty()) {
+            value(partial_);
+            partial_.clear();
+        }
+        if (builder_.depth())
+            error(offset_, "missing '}'");
+        offset_ = 0;
+        return builder_.finish();
+    }
+
+  private:
+    // the C locale white space, without the cost of isspace()
+    static bool is_space(char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); }
+    static bool is_delimiter(char ch) { return ch == '{' || ch == '}' || is_space(ch); }
+
+    void value(std::string_view s) { builder_.value(text_codec<T>::parse(s)); }
+
+    void open(size_t at) {
+        if (!builder_.can_start_children())
+            error(at, "'{' must follow a value");
+        builder_.start_children();
+    }
+
+    void close(size_t at) {
+        if (!builder_.depth())
+            error(at, "unexpected '}'");
+        builder_.end_children();
+    }
+
+    [[noreturn]] static void error(size_t at, const char *what) {
+        std::ostringstream os;
+        os << "parse_compact: " << what << " at offset " << at;
+        throw std::runtime_error(os.str());
+    }
+
+    tree_builder<T> builder_;
+    std::string partial_; // a value split across chunks
+    size_t offset_;
+};
+
+// parse the output of compact_string
+template <typename T> multivector<T> parse_compact(std::string_view s) {
+    compact_parser<T> parser;
+    parser.feed(s);
+    return parser.finish();
+}
+
+// parse compact_string output from a stream, reading it in large chunks
+template <typename T> multivector<T> parse_compact(std::istream &is) {
+    compact_parser<T> parser;
+    std::vector<char> buf(64 * 1024);
+    while (is.read(buf.data(), buf.size()) || is.gcount())
+        parser.feed(std::string_view(buf.data(), is.gcount()));
+    return parser.finish();
+}
+
+// convert to a table string with the parent pointer of each item
+template <typename Cursor> inline std::string to_debug_text(Cursor parent) {
+    std::string s;
+    text_writer<Cursor> w(parent, text_writer<Cursor>::debug);
+    while (w.next(s))
+        ;
+    return s;
+}
+
 template <typename T>
 inline std::string to_debug_text(const multivector<T> &tree) {
-    typedef typename multivector<T>::const_cursor cursor_type;
-    std::ostringstream ss;
-    auto r = tree.root();
-    // to_debug_text(ss, *r);
-    ss << *r << " " << r.item_ref().parent << '\n';
-    recurse(r,
-            [&](cursor_type self, cursor_type, int level) {
-                ss << spaces(level * 2) << *self << " ";
-                ss << self.it_->parent << '\n';
-            },
-
-            [&](cursor_type, cursor_type, int) {} // nothing to do on the way up
-    );
-    return ss.str();
+    return to_debug_text(tree.root());
 }
 
 template <typename Cursor> inline Cursor leaf(Cursor c) {
@@ -858,6 +1580,11 @@ template <typename Cursor> inline void promote_last(Cursor parent) {
     parent.promote_last();
 }
 
+// shrink and relocate the descendants of parent, return the bytes reclaimed
+template <typename Cursor> inline size_t compact(Cursor parent) {
+    return parent.compact();
+}
+
 template <typename Cursor>
 inline typename Cursor::precursor_type to_precursor(Cursor c) {
     return c;
@@ -883,6 +1610,35 @@ void append(Cursor parent, ConstCursor from_parent) {
     append(parent, from_parent.begin(), from_parent.end());
 }
 
+namespace detail {
+// emplace moved values, so observers see each addition
+template <typename Cursor, typename Items> void graft_values(Cursor parent, Items &items) {
+    for (auto &i : items)
+        graft_values(parent.emplace(std::move(i.value)), i.nodes_);
+}
+} // namespace detail
+
+// Move the items of fragment, with their subtrees, to the end of parent's
+// children and leave fragment empty.  Unlike append, nothing is copied: each
+// subvector moves as a whole, so the cost is the number of top level items.
+// When parent's tree is observed the values are moved in one emplace at a
+// time instead.  The value of fragment's root is not moved.
+template <typename Cursor, typename T> void graft(Cursor parent, multivector<T> &&fragment) {
+    auto &from = fragment.root_.nodes_;
+    if (parent.tree() && parent.tree()->observed())
+        detail::graft_values(parent, from);
+    else if (!from.empty()) {
+        auto &to = parent.item_ref().nodes_;
+        auto first = to.size();
+        if (to.capacity() < first + from.size())
+            to.reserve(std::max(first + from.size(), 2 * first));
+        for (auto &i : from)
+            to.emplace_back(std::move(i));
+        parent.item_ref().relink(first);
+    }
+    from.clear();
+}
+
 #if 0 // this may not be a good idea
 template <typename T>
 inline std::ostream & operator<<(std::ostream & ss, const multivector<T> & a) {
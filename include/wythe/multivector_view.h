@@ -0,0 +1,404 @@
+#pragma once
+/*
+        multivector_view -- A read-only multivector over a flat buffer.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+#include "multivector.h"
+#include "serialize.h"
+
+namespace wythe {
+
+// The view layout is position independent: every reference is an index or
+// an offset from the start of the buffer, so a file can be mapped anywhere
+// and shared by many processes.  Items are numbered in breadth-first order
+// with the root as item 0, so each subvector is a contiguous run of items.
+//
+//   view_header | view_item[count] | values[count] | blob
+//
+// Trivially copyable values are stored in the values array.  Strings are
+// stored as an offset and length into the blob.
+
+struct view_header {
+    char magic[4];       // "mvv" version
+    uint32_t value_size; // size of a values array element
+    uint64_t count;      // number of items, including the root
+    uint64_t items;      // offset of the view_item array
+    uint64_t values;     // offset of the values array
+    uint64_t blob;       // offset of the blob
+    uint64_t bytes;      // total size
+    uint64_t reserved[2];
+};
+
+struct view_item {
+    uint64_t parent; // index of the parent, ~0 for the root
+    uint64_t first;  // index of the first child
+    uint64_t size;   // number of children
+};
+
+template <typename T, typename Enable = void> struct view_traits {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "multivector_view values must be trivially copyable or std::string");
+    typedef const T &reference;
+    static const uint32_t value_size = sizeof(T);
+    static const size_t alignment = alignof(T) > 8 ? alignof(T) : 8;
+
+    static uint64_t blob_size(const T &) { return 0; }
+    template <typename Sink>
+    static void write_value(Sink &sink, const T &v, uint64_t &) {
+        sink.write(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+    template <typename Sink> static void write_blob(Sink &, const T &) {}
+    static reference read(const char *values, const char *, uint64_t i) {
+        return reinterpret_cast<const T *>(values)[i];
+    }
+    static bool valid(const char *, uint64_t, uint64_t) { return true; }
+};
+
+template <> struct view_traits<std::string> {
+    typedef std::string_view reference;
+    static const uint32_t value_size = 2 * sizeof(uint64_t);
+    static const size_t alignment = 8;
+
+    static uint64_t blob_size(const std::string &v) { return v.size(); }
+    template <typename Sink>
+    static void write_value(Sink &sink, const std::string &v, uint64_t &offset) {
+        uint64_t r[2] = {offset, v.size()};
+        sink.write(reinterpret_cast<const char *>(r), sizeof(r));
+        offset += v.size();
+    }
+    template <typename Sink> static void write_blob(Sink &sink, const std::string &v) {
+        sink.write(v.data(), v.size());
+    }
+    static reference read(const char *values, const char *blob, uint64_t i) {
+        auto r = reinterpret_cast<const uint64_t *>(values) + 2 * i;
+        return reference(blob + r[0], r[1]);
+    }
+    // value i lies within a blob of blob_size bytes
+    static bool valid(const char *values, uint64_t blob_size, uint64_t i) {
+        auto r = reinterpret_cast<const uint64_t *>(values) + 2 * i;
+        return r[0] <= blob_size && r[1] <= blob_size - r[0];
+    }
+};
+
+template <typename T> struct multivector_view;
+template <typename Tree> struct index_linear_cursor;
+
+// A const cursor into a tree stored as a breadth-first item table, shared by
+// multivector_view and lazy_multivector.  Tree supplies item(p, i),
+// value(p, i) and parent_of(p) for item i whose parent is p.  It is random
+// access among siblings and, unlike a multivector cursor, parent() is
+// constant time.
+template <typename Tree> struct index_cursor {
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename Tree::value_type value_type;
+    typedef typename Tree::reference reference;
+    typedef const value_type *pointer;
+    typedef std::ptrdiff_t difference_type;
+    typedef index_cursor cursor_type;
+    typedef index_linear_cursor<Tree> linear_type;
+    static const uint64_t npos = ~uint64_t(0);
+
+    index_cursor() : v(nullptr), p(npos), i(0) {}
+    index_cursor(const Tree *v, uint64_t p, uint64_t i) : v(v), p(p), i(i) {}
+
+    reference operator*() const { return v->value(p, i); }
+
+    index_cursor &operator++() {
+        ++i;
+        return *this;
+    }
+    index_cursor operator++(int) {
+        auto temp = *this;
+        ++i;
+        return temp;
+    }
+    index_cursor &operator--() {
+        --i;
+        return *this;
+    }
+    index_cursor operator--(int) {
+        auto temp = *this;
+        --i;
+        return temp;
+    }
+    index_cursor &operator+=(difference_type n) {
+        i += n;
+        return *this;
+    }
+    index_cursor &operator-=(difference_type n) {
+        i -= n;
+        return *this;
+    }
+    friend index_cursor operator+(index_cursor x, difference_type n) { return x += n; }
+    friend index_cursor operator+(difference_type n, index_cursor x) { return x += n; }
+    friend index_cursor operator-(index_cursor x, difference_type n) { return x -= n; }
+    friend difference_type operator-(const index_cursor &x, const index_cursor &y) {
+        return difference_type(x.i - y.i);
+    }
+    reference operator[](difference_type n) const { return *(*this + n); }
+    // the value of child n
+    reference child(difference_type n) const { return *(begin() + n); }
+
+    // cursors are equal if they are at the same place in the same subvector,
+    // so the end() of one subvector never equals the begin() of the next
+    bool operator==(const index_cursor &b) const { return i == b.i && p == b.p && v == b.v; }
+    bool operator!=(const index_cursor &b) const { return !operator==(b); }
+    bool operator<(const index_cursor &b) const { return i < b.i; }
+    bool operator>(const index_cursor &b) const { return b < *this; }
+    bool operator<=(const index_cursor &b) const { return !(b < *this); }
+    bool operator>=(const index_cursor &b) const { return !(*this < b); }
+
+    // cursor specific operations
+    bool empty() const { return item().size == 0; }
+    size_t size() const { return item().size; }
+    index_cursor begin() const { return index_cursor(v, i, item().first); }
+    index_cursor end() const { return index_cursor(v, i, item().first + item().size); }
+    index_cursor cbegin() const { return begin(); }
+    index_cursor cend() const { return end(); }
+    bool is_root() const { return p == npos; }
+    index_cursor parent() const { return index_cursor(v, v->parent_of(p), p); }
+
+    decltype(auto) item() const { return v->item(p, i); }
+    uint64_t index() const { return i; }
+
+    const Tree *v;
+    uint64_t p; // index of the parent
+    uint64_t i; // index of this item
+};
+
+// Depth-first traversal.  Since parent() is constant time it needs no stack
+// of parents, just the parent it started under.
+template <typename Tree> struct index_linear_cursor {
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename Tree::value_type value_type;
+    typedef typename Tree::reference reference;
+    typedef const value_type *pointer;
+    typedef std::ptrdiff_t difference_type;
+
+    index_linear_cursor() : top(index_cursor<Tree>::npos) {}
+    index_linear_cursor(index_cursor<Tree> c) : c(c), top(c.p) {}
+
+    reference operator*() const { return *c; }
+
+    bool operator==(const index_linear_cursor &b) const { return c == b.c; }
+    bool operator!=(const index_linear_cursor &b) const { return !operator==(b); }
+
+    index_linear_cursor &operator++() {
+        if (!c.empty()) {
+            c = c.begin();
+            return *this;
+        }
+        while (c.p != top && c == c.parent().end() - 1)
+            c = c.parent();
+        ++c;
+        return *this;
+    }
+    index_linear_cursor operator++(int) {
+        auto temp = *this;
+        operator++();
+        return temp;
+    }
+
+    index_cursor<Tree> c;
+    uint64_t top; // parent of the subvector the traversal started in
+};
+
+template <typename T> using view_cursor = index_cursor<multivector_view<T>>;
+template <typename T> using view_linear_cursor = index_linear_cursor<multivector_view<T>>;
+
+template <typename T> struct multivector_view {
+    typedef T value_type;
+    typedef view_cursor<T> const_cursor;
+    typedef const_cursor cursor;
+    typedef view_linear_cursor<T> const_linear_cursor;
+    typedef typename view_traits<T>::reference reference;
+
+    multivector_view() : items_(nullptr), values_(nullptr), blob_(nullptr), count_(0) {}
+
+    // View a buffer written by write_view, the buffer must outlive the view.
+    // Every item is checked to be in range, so a corrupt buffer throws
+    // std::runtime_error here rather than misleading a cursor later.
+    multivector_view(const char *data, size_t bytes) { attach(data, bytes); }
+
+    // memory map a file written by write_view; pages are read on demand
+    static multivector_view open(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("multivector_view: cannot open " + path + ": " +
+                                     strerror(errno));
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("multivector_view: cannot stat " + path);
+        }
+        size_t bytes = st.st_size;
+        void *p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("multivector_view: cannot map " + path + ": " +
+                                     strerror(errno));
+        multivector_view v;
+        v.map_.reset(p, [bytes](void *p) { munmap(p, bytes); });
+        v.attach(static_cast<const char *>(p), bytes);
+        return v;
+    }
+
+    const_cursor root() const { return const_cursor(this, const_cursor::npos, 0); }
+    const_cursor begin() const { return root().begin(); }
+    const_cursor end() const { return root().end(); }
+    const_cursor cbegin() const { return begin(); }
+    const_cursor cend() const { return end(); }
+
+    bool empty() const { return count_ == 0 || items_[0].size == 0; }
+    size_t size() const { return count_ ? count_ - 1 : 0; }
+
+    const view_item &item(uint64_t i) const { return items_[i]; }
+    reference value(uint64_t i) const { return view_traits<T>::read(values_, blob_, i); }
+
+    // the interface of index_cursor, every item is in the buffer so p is unused
+    const view_item &item(uint64_t, uint64_t i) const { return item(i); }
+    reference value(uint64_t, uint64_t i) const { return value(i); }
+    uint64_t parent_of(uint64_t p) const { return items_[p].parent; }
+
+  private:
+    void attach(const char *data, size_t bytes) {
+        if (bytes < sizeof(view_header))
+            throw std::runtime_error("multivector_view: buffer too small");
+        if (reinterpret_cast<uintptr_t>(data) % view_traits<T>::alignment)
+            throw std::runtime_error("multivector_view: buffer is not aligned");
+        auto h = reinterpret_cast<const view_header *>(data);
+        if (memcmp(h->magic, "mvv\1", 4) != 0)
+            throw std::runtime_error("multivector_view: not a multivector view");
+        if (h->value_size != view_traits<T>::value_size)
+            throw std::runtime_error("multivector_view: value type mismatch");
+        if (h->bytes > bytes || h->count == 0 || h->items > h->values ||
+            h->values > h->blob || h->blob > h->bytes ||
+            h->count > (h->values - h->items) / sizeof(view_item) ||
+            h->count > (h->blob - h->values) / h->value_size)
+            throw std::runtime_error("multivector_view: corrupt header");
+        if (h->items % alignof(view_item) || h->values % view_traits<T>::alignment)
+            throw std::runtime_error("multivector_view: arrays are not aligned");
+        items_ = reinterpret_cast<const view_item *>(data + h->items);
+        values_ = data + h->values;
+        blob_ = data + h->blob;
+        count_ = h->count;
+
+        // each item's children follow it and name it as their parent, so
+        // every item is reached once and navigation stays in the buffer
+        auto n = count_;
+        if (items_[0].parent != const_cursor::npos)
+            throw std::runtime_error("multivector_view: corrupt items");
+        for (uint64_t k = 0; k < n; ++k) {
+            auto &i = items_[k];
+            if ((k && i.parent >= k) || i.size > n || i.first > n - i.size ||
+                (i.size && i.first <= k) ||
+                !view_traits<T>::valid(values_, h->bytes - h->blob, k))
+                throw std::runtime_error("multivector_view: corrupt items");
+            for (auto j = i.first; j < i.first + i.size; ++j)
+                if (items_[j].parent != k)
+                    throw std::runtime_error("multivector_view: corrupt items");
+        }
+    }
+
+    const view_item *items_;
+    const char *values_;
+    const char *blob_;
+    uint64_t count_;
+    std::shared_ptr<void> map_;
+};
+
+namespace detail {
+inline uint64_t view_align(uint64_t n, uint64_t a) { return (n + a - 1) / a * a; }
+
+template <typename Sink> inline void view_pad(Sink &sink, uint64_t n) {
+    static const char zeros[16] = {};
+    while (n) {
+        auto k = n < sizeof(zeros) ? n : sizeof(zeros);
+        sink.write(zeros, k);
+        n -= k;
+    }
+}
+} // namespace detail
+
+// write parent and its descendants in the view layout, parent becomes the root
+template <typename Cursor, typename Sink> void write_view(Cursor parent, Sink &&out) {
+    typedef typename Cursor::value_type value_type;
+    typedef view_traits<value_type> traits;
+    typedef typename multivector<value_type>::const_cursor const_cursor;
+    typedef typename std::remove_reference<Sink>::type sink_type;
+    std::unique_ptr<detail::buffered_sink<sink_type>> buffer(
+        new detail::buffered_sink<sink_type>(out));
+    auto &sink = *buffer;
+
+    // breadth-first order puts each subvector in a contiguous run
+    std::vector<const_cursor> order{const_cursor(parent)};
+    uint64_t blob = traits::blob_size(*parent);
+    for (size_t k = 0; k < order.size(); ++k) {
+        for (auto c = order[k].begin(); c != order[k].end(); ++c) {
+            order.push_back(c);
+            blob += traits::blob_size(*c);
+        }
+    }
+
+    view_header h = {};
+    memcpy(h.magic, "mvv\1", 4);
+    h.value_size = traits::value_size;
+    h.count = order.size();
+    h.items = sizeof(view_header);
+    h.values = detail::view_align(h.items + h.count * sizeof(view_item), traits::alignment);
+    h.blob = h.values + h.count * traits::value_size;
+    h.bytes = h.blob + blob;
+    sink.write(reinterpret_cast<const char *>(&h), sizeof(h));
+
+    // the children of item q are the next order[q].size() items
+    uint64_t next = 1, q = 0, left = order[0].size();
+    for (size_t k = 0; k < order.size(); ++k) {
+        view_item r = {view_cursor<value_type>::npos, next, order[k].size()};
+        if (k) {
+            while (left == 0)
+                left = order[++q].size();
+            r.parent = q;
+            --left;
+        }
+        next += r.size;
+        sink.write(reinterpret_cast<const char *>(&r), sizeof(r));
+    }
+    detail::view_pad(sink, h.values - (h.items + h.count * sizeof(view_item)));
+
+    uint64_t offset = 0;
+    for (auto &c : order)
+        traits::write_value(sink, *c, offset);
+    for (auto &c : order)
+        traits::write_blob(sink, *c);
+    sink.flush();
+}
+
+template <typename T, typename Sink>
+void write_view(const multivector<T> &tree, Sink &&sink) {
+    write_view(tree.root(), sink);
+}
+
+template <typename T> inline std::string compact_string(const multivector_view<T> &view) {
+    return compact_string(view.root());
+}
+
+template <typename T> inline std::string to_text(const multivector_view<T> &view) {
+    return to_text(view.root());
+}
+
+} // namespace wythe
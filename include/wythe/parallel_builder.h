@@ -0,0 +1,112 @@
+#pragma once
+/*
+        parallel_builder -- Build fragments of a multivector on many threads and
+        graft them in order.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// Builds parts of a tree on worker threads.
+//
+// Each job builds an independent fragment, a multivector of its own, and is
+// bound to a parent in the tree.  run() builds the fragments on up to threads
+// threads while the calling thread grafts each finished fragment under its
+// parent by move, in the order the jobs were added, so the result is the same
+// whatever the number of threads.  The calling thread builds fragments too
+// while the next one to graft is not ready.
+//
+// A parent is kept as its index path, which grafting, an append, does not
+// change, so one job's parent may be a descendant of another's.  The tree must
+// not be used by other threads during run().
+template <typename T> struct parallel_builder {
+    typedef typename multivector<T>::cursor cursor;
+    typedef std::function<void(multivector<T> &)> build_type;
+
+    explicit parallel_builder(multivector<T> &tree) : tree(tree) {}
+
+    // queue build(fragment), to be grafted under parent
+    void add(cursor parent, build_type build) {
+        jobs.push_back(job{path_of(parent), std::move(build)});
+    }
+
+    // the jobs queued
+    size_t size() const { return jobs.size(); }
+
+    // Build and graft the queued jobs.  If a job, or grafting its fragment,
+    // throws, the fragments of the jobs before it are grafted, the rest are
+    // dropped, and the exception is rethrown once the workers have stopped.
+    void run(unsigned threads = 0) {
+        if (!threads)
+            threads = std::thread::hardware_concurrency();
+        auto n = jobs.size();
+        std::vector<multivector<T>> fragments(n);
+        std::vector<std::exception_ptr> errors(n);
+        std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[n]);
+        for (size_t k = 0; k < n; ++k)
+            done[k].store(false, std::memory_order_relaxed);
+        std::atomic<size_t> next(0);
+
+        // build the next unclaimed job, false if there is none
+        auto build_one = [&] {
+            auto k = next.fetch_add(1);
+            if (k >= n)
+                return false;
+            try {
+                jobs[k].build(fragments[k]);
+            } catch (...) {
+                errors[k] = std::current_exception();
+            }
+            done[k].store(true, std::memory_order_release);
+            done[k].notify_one();
+            return true;
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads && t < n; ++t)
+            pool.emplace_back([&] { while (build_one()) ; });
+
+        std::exception_ptr error;
+        for (size_t k = 0; k < n; ++k) {
+            while (!done[k].load(std::memory_order_acquire) && build_one())
+                ;
+            done[k].wait(false, std::memory_order_acquire);
+            error = errors[k];
+            if (!error) {
+                // the workers must be joined before anything propagates
+                try {
+                    graft(at_path(tree.root(), jobs[k].parent), std::move(fragments[k]));
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            if (error) {
+                next = n;
+                break;
+            }
+        }
+        for (auto &t : pool)
+            t.join();
+        jobs.clear();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+  private:
+    struct job {
+        std::vector<size_t> parent;
+        build_type build;
+    };
+    multivector<T> &tree;
+    std::vector<job> jobs;
+};
+
+} // namespace wythe
@@ -0,0 +1,271 @@
+#pragma once
+/*
+        parallel_serialize -- Serialize and deserialize on many threads.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "serialize.h"
+
+namespace wythe {
+
+// The chunked format splits the tree at a depth D.  The items above D are
+// the skeleton, written in preorder as in the binary format.  Each item at
+// depth D starts a subtree, and runs of these subtrees, in preorder, are
+// independently encoded blocks, so blocks are written and read in parallel.
+//
+//   "mvc" version | varint D | skeleton | varint B | table | block ...
+//   table: varint subtrees, varint bytes, for each block
+//   block: item | varint n | descendants ..., for each subtree
+
+namespace detail {
+static const char chunked_magic[4] = {'m', 'v', 'c', 1};
+
+inline unsigned thread_count(unsigned threads) {
+    if (!threads)
+        threads = std::thread::hardware_concurrency();
+    return threads ? threads : 1;
+}
+
+// call f(b) for each b in [0, n) on up to threads threads, then rethrow the
+// first exception, if any
+template <typename F> void parallel_for(unsigned threads, size_t n, F f) {
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex m;
+    auto work = [&] {
+        try {
+            for (size_t b; (b = next++) < n;)
+                f(b);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m);
+            if (!error)
+                error = std::current_exception();
+            next = n;
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned k = 1; k < threads && k < n; ++k)
+        pool.emplace_back(work);
+    work();
+    for (auto &t : pool)
+        t.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// The parents of the subtrees that start at depth D, for the smallest D at
+// which there are at least target subtrees.  first[k] is the number of
+// subtrees before those of parents[k].
+template <typename Cursor>
+size_t split_depth(Cursor root, size_t target, std::vector<Cursor> &parents,
+                   std::vector<size_t> &first) {
+    size_t depth = 1;
+    parents.assign(1, root);
+    size_t n = root.size();
+    while (n < target) {
+        std::vector<Cursor> next;
+        size_t m = 0;
+        for (auto p : parents)
+            for (auto c = p.begin(); c != p.end(); ++c)
+                if (!c.empty()) {
+                    next.push_back(c);
+                    m += c.size();
+                }
+        if (next.empty())
+            break;
+        parents.swap(next);
+        n = m;
+        ++depth;
+    }
+    first.clear();
+    n = 0;
+    for (auto p : parents) {
+        first.push_back(n);
+        n += p.size();
+    }
+    first.push_back(n);
+    return depth;
+}
+} // namespace detail
+
+// Write parent and its descendants in the chunked format, on up to threads
+// threads (0 for the number of cores).  Parent becomes the root.
+template <typename Cursor, typename Sink>
+void parallel_serialize(Cursor parent, Sink &&out, unsigned threads = 0) {
+    typedef typename Cursor::value_type value_type;
+    typedef typename multivector<value_type>::const_cursor const_cursor;
+    typedef typename std::remove_reference<Sink>::type sink_type;
+    threads = detail::thread_count(threads);
+
+    std::vector<const_cursor> parents;
+    std::vector<size_t> first;
+    auto depth = detail::split_depth(const_cursor(parent), threads * 16, parents, first);
+    size_t subtrees = first.back();
+    size_t count = std::min(subtrees, size_t(threads) * 16);
+
+    std::vector<std::string> blocks(count);
+    detail::parallel_for(threads, count, [&](size_t b) {
+        string_sink sink(blocks[b]);
+        size_t lo = subtrees * b / count, hi = subtrees * (b + 1) / count;
+        size_t k = std::upper_bound(first.begin(), first.end(), lo) - first.begin() - 1;
+        auto c = parents[k].begin() + (lo - first[k]);
+        for (auto i = lo; i < hi; ++i) {
+            while (c == parents[k].end())
+                c = parents[++k].begin();
+            detail::write_subtree(sink, c);
+            ++c;
+        }
+    });
+
+    std::unique_ptr<detail::buffered_sink<sink_type>> buffer(
+        new detail::buffered_sink<sink_type>(out));
+    auto &sink = *buffer;
+    sink.write(detail::chunked_magic, 4);
+    write_varint(sink, depth);
+
+    // the skeleton, in preorder to depth - 1
+    codec<value_type>::write(sink, *parent);
+    write_varint(sink, parent.size());
+    struct frame {
+        const_cursor first, last;
+        size_t depth;
+    };
+    std::vector<frame> stack;
+    if (depth > 1 && !parent.empty())
+        stack.push_back(frame{parent.begin(), parent.end(), 1});
+    while (!stack.empty()) {
+        auto d = stack.back().depth;
+        auto c = stack.back().first++;
+        if (stack.back().first == stack.back().last)
+            stack.pop_back();
+        codec<value_type>::write(sink, *c);
+        write_varint(sink, c.size());
+        if (d + 1 < depth && !c.empty())
+            stack.push_back(frame{c.begin(), c.end(), d + 1});
+    }
+
+    write_varint(sink, count);
+    for (size_t b = 0; b < count; ++b) {
+        write_varint(sink, subtrees * (b + 1) / count - subtrees * b / count);
+        write_varint(sink, blocks[b].size());
+    }
+    for (auto &b : blocks)
+        sink.write(b.data(), b.size());
+    sink.flush();
+}
+
+template <typename T, typename Sink>
+void parallel_serialize(const multivector<T> &tree, Sink &&sink, unsigned threads = 0) {
+    parallel_serialize(tree.root(), sink, threads);
+}
+
+// Read the chunked format from memory on up to threads threads (0 for the
+// number of cores).  Each block is read into detached items, which are then
+// moved into their parents in order.
+template <typename T>
+multivector<T> parallel_deserialize(const char *data, size_t bytes, unsigned threads = 0) {
+    typedef typename multivector<T>::cursor cursor;
+    threads = detail::thread_count(threads);
+    memory_source source(data, data + bytes);
+    char m[4];
+    source.read(m, 4);
+    if (memcmp(m, detail::chunked_magic, 4) != 0)
+        throw std::runtime_error("parallel_deserialize: not a chunked multivector binary");
+    auto depth = read_varint(source);
+    if (depth == 0)
+        throw std::runtime_error("parallel_deserialize: corrupt header");
+
+    // the skeleton, and the parents of the subtrees at depth
+    multivector<T> tree(root_value, codec<T>::read(source));
+    struct frame {
+        cursor parent;
+        uint64_t left;  // children still to read
+        uint64_t depth; // of the children
+    };
+    std::vector<std::pair<cursor, uint64_t>> parents;
+    std::vector<frame> stack;
+    if (auto n = read_varint(source)) {
+        tree.root().reserve(detail::reserve_count(source, n));
+        if (depth == 1)
+            parents.emplace_back(tree.root(), n);
+        else
+            stack.push_back(frame{tree.root(), n, 1});
+    }
+    while (!stack.empty()) {
+        auto d = stack.back().depth;
+        auto p = stack.back().parent;
+        if (--stack.back().left == 0)
+            stack.pop_back();
+        auto c = p.emplace(codec<T>::read(source));
+        if (auto n = read_varint(source)) {
+            c.reserve(detail::reserve_count(source, n));
+            if (d + 1 == depth)
+                parents.emplace_back(c, n);
+            else
+                stack.push_back(frame{c, n, d + 1});
+        }
+    }
+
+    auto count = read_varint(source);
+    if (count > bytes)
+        throw std::runtime_error("parallel_deserialize: corrupt table");
+    std::vector<uint64_t> subtrees(count), lengths(count), offsets(count + 1);
+    uint64_t total = 0;
+    for (uint64_t b = 0; b < count; ++b) {
+        subtrees[b] = read_varint(source);
+        lengths[b] = read_varint(source);
+        if (lengths[b] > bytes)
+            throw std::runtime_error("parallel_deserialize: corrupt table");
+        total += subtrees[b];
+    }
+    offsets[0] = source.p - data;
+    for (uint64_t b = 0; b < count; ++b)
+        offsets[b + 1] = offsets[b] + lengths[b];
+    uint64_t expected = 0;
+    for (auto &p : parents)
+        expected += p.second;
+    if (total != expected || offsets[count] != bytes)
+        throw std::runtime_error("parallel_deserialize: blocks do not fit the skeleton");
+
+    std::vector<std::vector<item<T>>> blocks(count);
+    // the block items belong to no tree until they are stitched in, so their
+    // cursors are never observed
+    const tree_anchor<T> detached{nullptr};
+    detail::parallel_for(threads, count, [&](size_t b) {
+        memory_source s(data + offsets[b], data + offsets[b + 1]);
+        auto &items = blocks[b];
+        items.reserve(detail::reserve_count(s, subtrees[b]));
+        for (uint64_t i = 0; i < subtrees[b]; ++i) {
+            items.emplace_back(nullptr, codec<T>::read(s));
+            detail::read_children(s, cursor(nullptr, &items.back(), &detached),
+                                  read_varint(s));
+        }
+        if (!s.empty())
+            throw std::runtime_error("parallel_deserialize: corrupt block");
+    });
+
+    // stitch the subtrees into their reserved parents
+    size_t k = 0;
+    for (auto &items : blocks)
+        for (auto &i : items) {
+            while (parents[k].first.size() == parents[k].second)
+                ++k;
+            parents[k].first.item_ref().nodes_.emplace_back(std::move(i));
+        }
+    for (auto &p : parents)
+        p.first.item_ref().relink();
+    return tree;
+}
+
+template <typename T>
+multivector<T> parallel_deserialize(const std::string &s, unsigned threads = 0) {
+    return parallel_deserialize<T>(s.data(), s.size(), threads);
+}
+
+} // namespace wythe
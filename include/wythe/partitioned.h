@@ -0,0 +1,63 @@
+#pragma once
+/*
+        partitioned -- Concurrent mutation of disjoint subtrees.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// Lets threads mutate the subtrees of a parent's children concurrently.
+//
+// Each item owns the subvector of its children.  Mutating a subtree writes
+// only that subvector, the items below it, and the first child's link to its
+// parent, all inside the subtree.  So threads may mutate disjoint subtrees at
+// once, provided the items holding those subtrees never move: nothing may
+// add, remove or reorder the children of the shared ancestors, or compact
+// them, while the partitions are in use.
+//
+// partitioned pins the children of a parent as partitions.  A thread that
+// owns partition i mutates it through (*this)[i]; threads that share a
+// partition go through with(i, f), which holds that partition's lock.  intact()
+// reports whether the pinned subvector was changed after all.  Mutation
+// observers are not synchronized, so the tree must not be observed.
+template <typename T> struct partitioned {
+    typedef typename multivector<T>::cursor cursor;
+
+    explicit partitioned(cursor parent)
+        : parent(parent), data(parent.item_ref().nodes_.data()), n(parent.size()),
+          locks(new std::mutex[parent.size()]) {
+        if (parent.tree() && parent.tree()->observed())
+            throw std::logic_error("partitioned: the tree is observed");
+    }
+
+    // partition i, to be mutated by one thread at a time
+    cursor operator[](size_t i) const { return parent.begin() + i; }
+
+    // run f(partition i) while holding its lock
+    template <typename F> auto with(size_t i, F f) const {
+        std::lock_guard<std::mutex> g(locks[i]);
+        return f((*this)[i]);
+    }
+
+    size_t size() const { return n; }
+
+    // true if the partitions have not moved
+    bool intact() const {
+        return parent.item_ref().nodes_.data() == data && parent.size() == n;
+    }
+
+  private:
+    cursor parent;
+    const item<T> *data;
+    size_t n;
+    std::unique_ptr<std::mutex[]> locks;
+};
+
+} // namespace wythe
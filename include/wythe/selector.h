@@ -0,0 +1,261 @@
+#pragma once
+/*
+        selector -- Compiled path queries over multivectors.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// A selector is a sequence of steps, each an axis, a test and any filters:
+//
+//   /test     a child of the current items (also the first step without /)
+//   //test    a descendant of the current items, at any depth
+//   *         any value
+//   name      a value equal to the text, compared with == std::string when T
+//             supports it, else parsed with text_codec<T>
+//   "a/b"     the same, quoted, with \ escaping the next character
+//   [n]       the item is child n of its parent
+//   [?name]   the named predicate holds for the value
+//
+// For example "//record/crc" selects every child crc of a record at any depth,
+// and "/*[2]//*[?big]" the big descendants of the third top level item.
+//
+// A selector is compiled once and applied to any number of trees.  select()
+// returns a lazy range that visits each item at most once, in depth-first
+// order, and skips the subtrees where no step can match.
+template <typename T> struct selector {
+    typedef std::function<bool(const T &)> predicate;
+
+    explicit selector(std::string_view text,
+                      std::initializer_list<std::pair<const std::string, predicate>> predicates = {})
+        : selector(text, std::map<std::string, predicate>(predicates)) {}
+
+    selector(std::string_view text, const std::map<std::string, predicate> &predicates) {
+        size_t i = 0;
+        auto fail = [&](const char *what) {
+            throw std::runtime_error(std::string("selector: ") + what + " at offset " +
+                                     std::to_string(i));
+        };
+        while (i < text.size()) {
+            step s;
+            if (text[i] == '/') {
+                ++i;
+                if (i < text.size() && text[i] == '/') {
+                    s.descendant = true;
+                    ++i;
+                }
+            } else if (!steps.empty())
+                fail("expected /");
+
+            // the test
+            if (i < text.size() && text[i] == '*') {
+                ++i;
+            } else {
+                std::string lit;
+                if (i < text.size() && text[i] == '"') {
+                    for (++i; i < text.size() && text[i] != '"'; ++i) {
+                        if (text[i] == '\\' && i + 1 < text.size())
+                            ++i;
+                        lit.push_back(text[i]);
+                    }
+                    if (i == text.size())
+                        fail("unterminated string");
+                    ++i;
+                } else {
+                    for (; i < text.size() && !strchr("/[]\"", text[i]); ++i)
+                        lit.push_back(text[i]);
+                    if (lit.empty())
+                        fail("expected a test");
+                }
+                s.literal = literal(lit);
+            }
+
+            // the filters
+            while (i < text.size() && text[i] == '[') {
+                auto close = text.find(']', i);
+                if (close == std::string_view::npos)
+                    fail("expected ]");
+                auto f = text.substr(i + 1, close - i - 1);
+                if (!f.empty() && f[0] == '?') {
+                    auto p = predicates.find(std::string(f.substr(1)));
+                    if (p == predicates.end())
+                        fail("unknown predicate");
+                    s.predicates.push_back(p->second);
+                } else {
+                    size_t n;
+                    auto r = std::from_chars(f.data(), f.data() + f.size(), n);
+                    if (f.empty() || r.ec != std::errc() || r.ptr != f.data() + f.size())
+                        fail("expected an index or ?predicate");
+                    s.index = n;
+                }
+                i = close + 1;
+            }
+            steps.push_back(std::move(s));
+            if (steps.size() > 64)
+                fail("too many steps");
+        }
+        if (steps.empty())
+            fail("empty selector");
+    }
+
+    template <typename Cursor> struct selection;
+
+    // the items below context that match, a range of Cursor
+    template <typename Cursor> selection<Cursor> select(Cursor context) const {
+        return selection<Cursor>(this, context);
+    }
+
+    size_t size() const { return steps.size(); }
+
+  private:
+    // a literal compares with std::string, or is parsed into a T
+    struct text_equal {
+        std::string text;
+        bool operator()(const T &v) const { return v == text; }
+    };
+    struct value_equal {
+        T value;
+        bool operator()(const T &v) const { return v == value; }
+    };
+    typedef std::conditional_t<requires(const T &v, const std::string &s) { v == s; },
+                               text_equal, value_equal>
+        literal_type;
+
+    static literal_type literal(const std::string &s) {
+        if constexpr (std::is_same_v<literal_type, text_equal>)
+            return literal_type{s};
+        else
+            return literal_type{text_codec<T>::parse(s)};
+    }
+
+    struct step {
+        bool descendant = false;
+        std::optional<literal_type> literal;
+        std::optional<size_t> index;
+        std::vector<predicate> predicates;
+
+        template <typename Cursor> bool matches(const Cursor &c) const {
+            if (index && c.item_ref().sibling_index() != *index)
+                return false;
+            if (literal && !(*literal)(*c))
+                return false;
+            for (auto &p : predicates)
+                if (!p(*c))
+                    return false;
+            return true;
+        }
+    };
+
+    std::vector<step> steps;
+
+  public:
+    template <typename Cursor> struct selection {
+        struct iterator {
+            typedef std::input_iterator_tag iterator_category;
+            typedef Cursor value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const Cursor *pointer;
+            typedef const Cursor &reference;
+
+            iterator() : s(nullptr) {}
+            iterator(const selector *s, Cursor context) : s(s) {
+                if (!context.empty())
+                    stack.push_back(frame{context.begin(), context.end(), 1});
+                ++*this;
+            }
+
+            reference operator*() const { return current; }
+            pointer operator->() const { return &current; }
+
+            // visit the items in depth-first order until the next match
+            iterator &operator++() {
+                auto last = uint64_t(1) << (s->steps.size() - 1);
+                while (!stack.empty()) {
+                    auto &f = stack.back();
+                    if (f.next == f.end) {
+                        stack.pop_back();
+                        continue;
+                    }
+                    auto c = f.next++;
+                    uint64_t below = 0;
+                    bool found = false;
+                    for (auto m = f.active; m; m &= m - 1) {
+                        auto k = std::countr_zero(m);
+                        auto &st = s->steps[k];
+                        if (st.descendant)
+                            below |= uint64_t(1) << k;
+                        if (st.matches(c)) {
+                            if ((uint64_t(1) << k) == last)
+                                found = true;
+                            else
+                                below |= uint64_t(1) << (k + 1);
+                        }
+                    }
+                    if (below && !c.empty())
+                        stack.push_back(frame{c.begin(), c.end(), below});
+                    if (found) {
+                        current = c;
+                        return *this;
+                    }
+                }
+                s = nullptr;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+
+            friend bool operator==(const iterator &a, const iterator &b) {
+                return a.s == b.s && (!a.s || a.current == b.current);
+            }
+            friend bool operator!=(const iterator &a, const iterator &b) { return !(a == b); }
+
+          private:
+            // siblings [next, end) and the steps they are tested against
+            struct frame {
+                Cursor next, end;
+                uint64_t active;
+            };
+            const selector *s;
+            std::vector<frame> stack;
+            Cursor current;
+        };
+
+        selection(const selector *s, Cursor context) : s(s), context(context) {}
+
+        iterator begin() const { return iterator(s, context); }
+        iterator end() const { return iterator(); }
+
+        // the number of matches, by running the query
+        size_t count() const { return std::distance(begin(), end()); }
+        // all the matches
+        std::vector<Cursor> to_vector() const { return std::vector<Cursor>(begin(), end()); }
+
+      private:
+        const selector *s;
+        Cursor context;
+    };
+};
+
+// the items below context that match the selector
+template <typename Cursor, typename T>
+typename selector<T>::template selection<Cursor> select(Cursor context, const selector<T> &s) {
+    return s.template select<Cursor>(context);
+}
+
+} // namespace wythe
@@ -0,0 +1,300 @@
+#pragma once
+/*
+        serialize -- A compact binary format for multivectors.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "multivector.h"
+
+namespace wythe {
+
+// The binary format is a 4 byte header followed by the tree in preorder.
+// Each item is its value, written by codec<value_type>, followed by a varint
+// count of its children.  The root item is included.
+//
+//   "mvb" version | root value | n | child 1 value | n1 | ... | child n ...
+//
+// Varints are byte order independent, but the default codec copies
+// arithmetic and enum values in host byte order, so a file is only portable
+// between hosts of the same byte order unless codec<T> is specialized.
+
+// A Sink has:   void write(const char * p, size_t n);
+// A Source has: void read(char * p, size_t n); which throws if short.
+
+// append to a std::string
+struct string_sink {
+    explicit string_sink(std::string &s) : s(s) {}
+    void write(const char *p, size_t n) { s.append(p, n); }
+    std::string &s;
+};
+
+// write to a std::ostream
+struct ostream_sink {
+    explicit ostream_sink(std::ostream &os) : os(os) {}
+    void write(const char *p, size_t n) {
+        if (!os.write(p, n))
+            throw std::runtime_error("ostream_sink: write failed");
+    }
+    std::ostream &os;
+};
+
+// write to a stdio FILE
+struct file_sink {
+    explicit file_sink(FILE *f) : f(f) {}
+    void write(const char *p, size_t n) {
+        if (fwrite(p, 1, n, f) != n)
+            throw std::runtime_error("file_sink: write failed");
+    }
+    FILE *f;
+};
+
+#ifndef _WIN32
+// write all of each buffer to a file descriptor, which should be blocking
+struct fd_sink {
+    explicit fd_sink(int fd) : fd(fd) {}
+    void write(const char *p, size_t n) {
+        while (n) {
+            auto r = ::write(fd, p, n);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error(std::string("fd_sink: ") + strerror(errno));
+            }
+            p += r;
+            n -= r;
+        }
+    }
+    int fd;
+};
+#endif
+
+// read from a contiguous range of bytes
+struct memory_source {
+    memory_source(const char *first, const char *last) : p(first), last(last) {}
+    explicit memory_source(const std::string &s)
+        : p(s.data()), last(s.data() + s.size()) {}
+    void read(char *d, size_t n) {
+        if (n > size_t(last - p))
+            throw std::runtime_error("memory_source: unexpected end of input");
+        memcpy(d, p, n);
+        p += n;
+    }
+    bool empty() const { return p == last; }
+    size_t remaining() const { return last - p; }
+    const char *p;
+    const char *last;
+};
+
+// read from a std::istream
+struct istream_source {
+    explicit istream_source(std::istream &is) : is(is) {}
+    void read(char *d, size_t n) {
+        if (!is.read(d, n))
+            throw std::runtime_error("istream_source: unexpected end of input");
+    }
+    std::istream &is;
+};
+
+// LEB128 unsigned varints
+template <typename Sink> inline void write_varint(Sink &sink, uint64_t v) {
+    char buf[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+        buf[n++] = char(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = char(v);
+    sink.write(buf, n);
+}
+
+template <typename Source> inline uint64_t read_varint(Source &source) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        char c;
+        source.read(&c, 1);
+        v |= uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return v;
+    }
+    throw std::runtime_error("read_varint: varint is too long");
+}
+
+// The per value_type codec.  Specialize codec<T> for other value types, with:
+//     template <typename Sink> static void write(Sink & sink, const T & v);
+//     template <typename Source> static T read(Source & source);
+template <typename T, typename Enable = void> struct codec;
+
+// arithmetic and enum values are copied in host byte order
+template <typename T>
+struct codec<T, typename std::enable_if<std::is_arithmetic<T>::value ||
+                                        std::is_enum<T>::value>::type> {
+    template <typename Sink> static void write(Sink &sink, const T &v) {
+        sink.write(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+    template <typename Source> static T read(Source &source) {
+        T v;
+        source.read(reinterpret_cast<char *>(&v), sizeof(T));
+        return v;
+    }
+};
+
+// strings are a varint length followed by the characters
+template <> struct codec<std::string> {
+    template <typename Sink> static void write(Sink &sink, const std::string &v) {
+        write_varint(sink, v.size());
+        sink.write(v.data(), v.size());
+    }
+    template <typename Source> static std::string read(Source &source) {
+        std::string v(read_varint(source), '\0');
+        if (!v.empty())
+            source.read(&v[0], v.size());
+        return v;
+    }
+};
+
+namespace detail {
+static const char binary_magic[4] = {'m', 'v', 'b', 1};
+
+// gathers the many small writes of serialize into large writes to the sink
+// The writer calls flush() when done; the destructor does not, so an error
+// from the sink is thrown there rather than from a destructor.
+template <typename Sink> struct buffered_sink {
+    explicit buffered_sink(Sink &sink) : sink(sink), n(0) {}
+    void write(const char *p, size_t len) {
+        if (len > sizeof(buf) - n) {
+            flush();
+            if (len > sizeof(buf)) {
+                sink.write(p, len);
+                return;
+            }
+        }
+        memcpy(buf + n, p, len);
+        n += len;
+    }
+    void flush() {
+        if (n)
+            sink.write(buf, n);
+        n = 0;
+    }
+    Sink &sink;
+    size_t n;
+    char buf[64 * 1024];
+};
+
+template <typename Source> inline void read_magic(Source &source) {
+    char m[4];
+    source.read(m, 4);
+    if (memcmp(m, binary_magic, 4) != 0)
+        throw std::runtime_error("deserialize: not a multivector binary");
+}
+} // namespace detail
+
+namespace detail {
+// The space to reserve for n items read from source.  Each item takes at
+// least one byte, so a corrupt count cannot reserve more than a memory source
+// holds.  Other sources reserve at most max_reserve and then grow.
+static const uint64_t max_reserve = 1 << 16;
+template <typename Source>
+auto reserve_limit(const Source &source, int) -> decltype(uint64_t(source.remaining())) {
+    return source.remaining();
+}
+template <typename Source> uint64_t reserve_limit(const Source &, long) { return max_reserve; }
+template <typename Source> uint64_t reserve_count(const Source &source, uint64_t n) {
+    return std::min(n, reserve_limit(source, 0));
+}
+
+// write an item and its descendants in preorder
+template <typename Cursor, typename Sink> void write_subtree(Sink &sink, Cursor parent) {
+    typedef typename Cursor::value_type value_type;
+    typedef typename multivector<value_type>::const_cursor const_cursor;
+    codec<value_type>::write(sink, *parent);
+    write_varint(sink, parent.size());
+
+    // iterate, so deep trees do not exhaust the stack
+    std::vector<std::pair<const_cursor, const_cursor>> stack;
+    if (!parent.empty())
+        stack.emplace_back(parent.begin(), parent.end());
+    while (!stack.empty()) {
+        auto c = stack.back().first++;
+        if (stack.back().first == stack.back().second)
+            stack.pop_back();
+        codec<value_type>::write(sink, *c);
+        write_varint(sink, c.size());
+        if (!c.empty())
+            stack.emplace_back(c.begin(), c.end());
+    }
+}
+
+// read n children of parent and their descendants
+template <typename Cursor, typename Source>
+void read_children(Source &source, Cursor parent, uint64_t n) {
+    typedef typename Cursor::value_type value_type;
+    std::vector<std::pair<Cursor, uint64_t>> stack;
+    if (n) {
+        parent.reserve(reserve_count(source, n));
+        stack.emplace_back(parent, n);
+    }
+    while (!stack.empty()) {
+        auto p = stack.back().first;
+        if (--stack.back().second == 0)
+            stack.pop_back();
+        auto c = p.emplace(codec<value_type>::read(source));
+        if (auto n = read_varint(source)) {
+            c.reserve(reserve_count(source, n));
+            stack.emplace_back(c, n);
+        }
+    }
+}
+} // namespace detail
+
+// write parent and all of its descendants, parent becomes the root
+template <typename Cursor, typename Sink>
+void serialize(Cursor parent, Sink &&out) {
+    typedef typename std::remove_reference<Sink>::type sink_type;
+    std::unique_ptr<detail::buffered_sink<sink_type>> buffer(
+        new detail::buffered_sink<sink_type>(out));
+    auto &sink = *buffer;
+    sink.write(detail::binary_magic, 4);
+    detail::write_subtree(sink, parent);
+    sink.flush();
+}
+
+template <typename T, typename Sink>
+void serialize(const multivector<T> &tree, Sink &&sink) {
+    serialize(tree.root(), sink);
+}
+
+template <typename T> std::string serialize(const multivector<T> &tree) {
+    std::string s;
+    serialize(tree.root(), string_sink(s));
+    return s;
+}
+
+// read a multivector.  Each subvector is sized exactly from its stored count,
+// though sources other than memory_source reserve at most
+// detail::max_reserve children up front.
+template <typename T, typename Source>
+multivector<T> deserialize(Source &&source) {
+    detail::read_magic(source);
+    multivector<T> tree(root_value, codec<T>::read(source));
+    detail::read_children(source, tree.root(), read_varint(source));
+    return tree;
+}
+
+} // namespace wythe
@@ -0,0 +1,208 @@
+#pragma once
+/*
+        shared_multivector -- Snapshot reads of a multivector while one writer
+        updates it.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// A multivector shared by many reader threads and one writer thread.
+//
+// Readers see immutable versions of the tree.  A read pins the current version
+// for as long as the snapshot lives, with one atomic store and two loads, and
+// never waits for the writer.  The writer changes a private version with
+// update(f) and makes it current with publish(), a single atomic exchange.
+//
+// Versions that are no longer current are reclaimed by epochs: each read
+// records the epoch it started in, and a version retired in epoch e is free
+// once no read is active from an epoch <= e.  The writer recycles a free
+// version by replaying onto it the updates it has not seen, so a publish costs
+// the edits since the last one, not a copy of the tree.  Only when every older
+// version is still pinned does it copy the tree.  Updates must therefore be
+// deterministic functions of the tree, as they may run more than once.
+template <typename T> struct shared_multivector {
+    typedef std::function<void(multivector<T> &)> update_type;
+
+  private:
+    struct version {
+        multivector<T> tree;
+        uint64_t seq;    // the number of updates applied
+        uint64_t epoch;  // when it was retired
+    };
+
+    // a reader's epoch, on its own cache line
+    struct alignas(64) slot {
+        std::atomic<bool> used{false};
+        std::atomic<uint64_t> epoch{idle};
+    };
+
+    static constexpr uint64_t idle = ~uint64_t(0);
+
+  public:
+    // A consistent view of one version, valid until destroyed.
+    struct snapshot {
+        snapshot(snapshot &&b) noexcept : s(b.s), v(b.v) { b.s = nullptr; }
+        snapshot(const snapshot &) = delete;
+        snapshot &operator=(const snapshot &) = delete;
+        ~snapshot() {
+            if (s)
+                s->epoch.store(idle, std::memory_order_release);
+        }
+
+        const multivector<T> &tree() const { return v->tree; }
+        typename multivector<T>::const_cursor root() const { return v->tree.root(); }
+        // the number of updates this version includes
+        uint64_t seq() const { return v->seq; }
+
+      private:
+        friend struct shared_multivector;
+        snapshot(slot *s, const version *v) : s(s), v(v) {}
+        slot *s;
+        const version *v;
+    };
+
+    // A reader thread's handle, holding one of the reader slots.  A reader
+    // has at most one snapshot at a time.
+    struct reader {
+        reader(reader &&b) noexcept : m(b.m), s(b.s) { b.s = nullptr; }
+        reader(const reader &) = delete;
+        reader &operator=(const reader &) = delete;
+        ~reader() {
+            if (s)
+                s->used.store(false, std::memory_order_release);
+        }
+
+        // wait-free
+        snapshot read() const {
+            s->epoch.store(m->epoch.load(), std::memory_order_seq_cst);
+            return snapshot(s, m->current.load(std::memory_order_seq_cst));
+        }
+
+      private:
+        friend struct shared_multivector;
+        reader(const shared_multivector *m, slot *s) : m(m), s(s) {}
+        const shared_multivector *m;
+        slot *s;
+    };
+
+    explicit shared_multivector(multivector<T> tree = multivector<T>(), size_t max_readers = 128)
+        : slots(max_readers), epoch(1), published_seq(0), copies_(0) {
+        auto v = std::unique_ptr<version>(new version{std::move(tree), 0, 0});
+        working.reset(new version{v->tree, 0, 0});
+        current.store(v.get());
+        published = std::move(v);
+    }
+
+    shared_multivector(const shared_multivector &) = delete;
+    shared_multivector &operator=(const shared_multivector &) = delete;
+
+    // claim a reader slot, throws std::runtime_error if all are in use
+    reader make_reader() const {
+        for (auto &s : slots) {
+            bool expected = false;
+            if (s.used.compare_exchange_strong(expected, true))
+                return reader(this, &s);
+        }
+        throw std::runtime_error("shared_multivector: too many readers");
+    }
+
+    // writer: apply f to the next version, unseen by readers until publish()
+    void update(update_type f) {
+        f(working->tree);
+        log.push_back(std::move(f));
+        ++working->seq;
+    }
+
+    // writer: make the updates visible to new snapshots
+    void publish() {
+        working->epoch = 0;
+        auto next = std::move(working);
+        published_seq = next->seq;
+        auto old = std::move(published);
+        current.store(next.get(), std::memory_order_seq_cst);
+        published = std::move(next);
+        old->epoch = epoch.fetch_add(1, std::memory_order_seq_cst);
+        retired.push_back(std::move(old));
+        working = recycle();
+    }
+
+    // writer: update and publish
+    void write(update_type f) {
+        update(std::move(f));
+        publish();
+    }
+
+    // writer: the versions kept, including the current and the working one
+    size_t versions() const { return retired.size() + 2; }
+    // writer: the number of times a version was made by copying the tree
+    size_t copies() const { return copies_; }
+
+  private:
+    // the oldest epoch of any active read, or idle
+    uint64_t oldest_read() const {
+        uint64_t e = idle;
+        for (auto &s : slots)
+            e = std::min(e, s.epoch.load(std::memory_order_seq_cst));
+        return e;
+    }
+
+    // a version to write into, brought up to the published state
+    std::unique_ptr<version> recycle() {
+        auto oldest = oldest_read();
+        std::unique_ptr<version> v;
+        for (auto i = retired.begin(); i != retired.end(); ++i)
+            if ((*i)->epoch < oldest) {
+                v = std::move(*i);
+                retired.erase(i);
+                break;
+            }
+        // free the other unpinned versions, keeping one spare
+        for (auto i = retired.begin(); i != retired.end();)
+            if ((*i)->epoch < oldest && retired.size() > 1)
+                i = retired.erase(i);
+            else
+                ++i;
+
+        if (v) {
+            auto first = published_seq - log.size();
+            for (auto k = v->seq; k < published_seq; ++k)
+                log[k - first](v->tree);
+            v->seq = published_seq;
+        } else {
+            v.reset(new version{published->tree, published_seq, 0});
+            ++copies_;
+        }
+
+        // drop the updates every kept version has seen
+        auto keep = v->seq;
+        for (auto &r : retired)
+            keep = std::min(keep, r->seq);
+        auto first = published_seq - log.size();
+        log.erase(log.begin(), log.begin() + (keep - first));
+        return v;
+    }
+
+    mutable std::vector<slot> slots;
+    std::atomic<uint64_t> epoch;
+    std::atomic<const version *> current;
+
+    // the writer's state
+    std::unique_ptr<version> published, working;
+    std::vector<std::unique_ptr<version>> retired;
+    std::deque<update_type> log; // since the oldest version kept
+    uint64_t published_seq;
+    size_t copies_;
+};
+
+} // namespace wythe
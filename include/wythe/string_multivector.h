@@ -0,0 +1,187 @@
+#pragma once
+/*
+        string_multivector -- A multivector of interned strings.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// A process wide pool of unique strings.  Each string is stored once and is
+// identified by a 32 bit id.  Id 0 is always the empty string.
+//
+// intern() takes a lock; str() does not.  The strings are found through
+// segments that never move, segment k holding 64 << k of them, and an id is
+// only handed out once its string is in place.
+class string_pool {
+  public:
+    typedef uint32_t id_type;
+
+    static string_pool &instance() {
+        static string_pool pool;
+        return pool;
+    }
+
+    // return the id of s, adding it to the pool if necessary
+    id_type intern(const std::string &s) {
+        std::lock_guard<std::mutex> lock(m_);
+        auto i = ids_.find(s);
+        if (i != ids_.end())
+            return i->second;
+        if (size_ == UINT32_MAX)
+            throw std::length_error("string_pool is full");
+        auto id = id_type(size_);
+        auto k = segment_of(id);
+        auto strings = segments_[k].load(std::memory_order_relaxed);
+        if (!strings) {
+            strings = new const std::string *[first << k];
+            segments_[k].store(strings, std::memory_order_release);
+        }
+        i = ids_.emplace(s, id).first;
+        strings[offset(id, k)] = &i->first;
+        ++size_;
+        return id;
+    }
+
+    // lock-free; id must have come from intern()
+    const std::string &str(id_type id) const {
+        auto k = segment_of(id);
+        return *segments_[k].load(std::memory_order_acquire)[offset(id, k)];
+    }
+
+    // number of unique strings
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_);
+        return size_;
+    }
+
+    // approximate heap memory held by the pool
+    size_t bytes() const {
+        std::lock_guard<std::mutex> lock(m_);
+        size_t n = ids_.bucket_count() * sizeof(void *);
+        for (size_t k = 0; k < std::size(segments_); ++k)
+            if (segments_[k].load(std::memory_order_relaxed))
+                n += (first << k) * sizeof(const std::string *);
+        for (auto &s : ids_) {
+            // one hash node per string, plus the string's own buffer
+            n += sizeof(s) + 2 * sizeof(void *);
+            if (s.first.capacity() > sizeof(std::string) - 1)
+                n += s.first.capacity() + 1;
+        }
+        return n;
+    }
+
+  private:
+    string_pool() {
+        for (auto &s : segments_)
+            s.store(nullptr, std::memory_order_relaxed);
+        intern(std::string());
+    }
+    ~string_pool() {
+        for (auto &s : segments_)
+            delete[] s.load();
+    }
+    string_pool(const string_pool &) = delete;
+    string_pool &operator=(const string_pool &) = delete;
+
+    static constexpr size_t first = 64;
+    static constexpr int first_bits = 7; // std::bit_width(first)
+
+    static size_t segment_of(size_t i) { return std::bit_width(i + first) - first_bits; }
+    static size_t offset(size_t i, size_t k) { return i + first - (first << k); }
+
+    mutable std::mutex m_;
+    // nodes of an unordered_map are stable, so the segments point at its keys
+    std::unordered_map<std::string, id_type> ids_;
+    std::atomic<const std::string **> segments_[27]; // enough for 2^32 ids
+    size_t size_ = 0;
+};
+
+// A string value that is stored as a 32 bit id in the string_pool.
+// Equality is an id comparison, ordering is lexicographic like std::string.
+struct interned_string {
+    typedef string_pool::id_type id_type;
+
+    interned_string() : id_(0) {}
+    interned_string(const std::string &s) : id_(string_pool::instance().intern(s)) {}
+    interned_string(const char *s) : interned_string(std::string(s)) {}
+
+    const std::string &str() const { return string_pool::instance().str(id_); }
+    operator const std::string &() const { return str(); }
+    id_type id() const { return id_; }
+    bool empty() const { return id_ == 0; }
+
+    friend bool operator==(interned_string a, interned_string b) {
+        return a.id_ == b.id_;
+    }
+    friend bool operator!=(interned_string a, interned_string b) {
+        return a.id_ != b.id_;
+    }
+    friend bool operator<(interned_string a, interned_string b) {
+        return a.id_ != b.id_ && a.str() < b.str();
+    }
+    friend bool operator>(interned_string a, interned_string b) { return b < a; }
+    friend bool operator<=(interned_string a, interned_string b) { return !(b < a); }
+    friend bool operator>=(interned_string a, interned_string b) { return !(a < b); }
+
+    // comparisons with plain strings do not add them to the pool
+    friend bool operator==(interned_string a, const std::string &b) {
+        return a.str() == b;
+    }
+    friend bool operator==(const std::string &a, interned_string b) {
+        return a == b.str();
+    }
+    friend bool operator!=(interned_string a, const std::string &b) {
+        return !(a == b);
+    }
+    friend bool operator!=(const std::string &a, interned_string b) {
+        return !(a == b);
+    }
+    friend bool operator==(interned_string a, const char *b) {
+        return a.str() == b;
+    }
+    friend bool operator!=(interned_string a, const char *b) {
+        return !(a == b);
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, interned_string s) {
+        return os << s.str();
+    }
+
+  private:
+    id_type id_;
+};
+
+// text is written straight from the pool and parsed strings are interned
+template <> struct text_codec<interned_string> {
+    template <typename Buffer> static void format(Buffer &buf, interned_string v) {
+        auto &s = v.str();
+        buf.append(s.data(), s.size());
+    }
+    static interned_string parse(std::string_view s) {
+        return interned_string(std::string(s));
+    }
+};
+
+// a multivector of strings that keeps 32 bits per node
+typedef multivector<interned_string> string_multivector;
+
+} // namespace wythe
+
+namespace std {
+template <> struct hash<wythe::interned_string> {
+    size_t operator()(wythe::interned_string s) const {
+        return std::hash<uint32_t>()(s.id());
+    }
+};
+} // namespace std
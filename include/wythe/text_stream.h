@@ -0,0 +1,137 @@
+#pragma once
+/*
+        text_stream -- Incremental text output of multivectors.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+#include "multivector.h"
+#include "serialize.h"
+
+namespace wythe {
+
+// Produces the text of a tree through a bounded buffer, so a large tree can
+// be written without holding its whole rendering in memory.  It is
+// resumable: take as many bytes as the destination will accept now and
+// continue later, for example when a non-blocking socket is writable again.
+//
+//     text_stream<cursor> s(tree.root(), s.table);
+//     while (!s.done()) {
+//         auto v = s.peek();
+//         auto n = ::write(fd, v.data(), v.size()); // may be partial
+//         if (n > 0) s.consume(n);
+//     }
+template <typename Cursor> struct text_stream {
+    typedef text_writer<Cursor> writer_type;
+    typedef typename writer_type::format_type format_type;
+    static constexpr format_type compact = writer_type::compact;
+    static constexpr format_type table = writer_type::table;
+    static constexpr format_type debug = writer_type::debug;
+
+    // the buffer is refilled in chunks of at least chunk bytes
+    text_stream(Cursor parent, format_type format, size_t chunk = 64 * 1024)
+        : writer(parent, format), chunk(chunk), pos(0), more(true) {
+        buf.reserve(chunk + 256);
+    }
+
+    // the next pending bytes, empty when all the text has been consumed
+    std::string_view peek() {
+        if (pos == buf.size())
+            fill();
+        return std::string_view(buf.data() + pos, buf.size() - pos);
+    }
+
+    // mark n bytes returned by peek() as written
+    void consume(size_t n) { pos += std::min(n, buf.size() - pos); }
+
+    // copy up to n bytes into dst, return the number copied, 0 when done
+    size_t read(char *dst, size_t n) {
+        size_t total = 0;
+        while (total < n) {
+            auto v = peek();
+            if (v.empty())
+                break;
+            auto k = std::min(v.size(), n - total);
+            memcpy(dst + total, v.data(), k);
+            consume(k);
+            total += k;
+        }
+        return total;
+    }
+
+    // write at most max bytes to sink, return the number written
+    template <typename Sink> size_t write_some(Sink &&sink, size_t max) {
+        size_t total = 0;
+        while (total < max) {
+            auto v = peek();
+            if (v.empty())
+                break;
+            auto k = std::min(v.size(), max - total);
+            sink.write(v.data(), k);
+            consume(k);
+            total += k;
+        }
+        return total;
+    }
+
+    // write everything that is left to sink
+    template <typename Sink> void write_all(Sink &&sink) {
+        for (auto v = peek(); !v.empty(); v = peek()) {
+            sink.write(v.data(), v.size());
+            consume(v.size());
+        }
+    }
+
+    bool done() { return peek().empty(); }
+
+  private:
+    void fill() {
+        buf.clear();
+        pos = 0;
+        while (more && buf.size() < chunk)
+            more = writer.next(buf);
+    }
+
+    writer_type writer;
+    std::string buf;
+    size_t chunk;
+    size_t pos;
+    bool more;
+};
+
+// Write the text of parent to a Sink, such as ostream_sink, file_sink or
+// fd_sink, in chunks of about chunk bytes.
+template <typename Cursor, typename Sink>
+void stream_text(Cursor parent, Sink &&sink, size_t chunk = 64 * 1024) {
+    text_stream<Cursor>(parent, text_stream<Cursor>::table, chunk).write_all(sink);
+}
+
+template <typename Cursor, typename Sink>
+void stream_compact(Cursor parent, Sink &&sink, size_t chunk = 64 * 1024) {
+    text_stream<Cursor>(parent, text_stream<Cursor>::compact, chunk).write_all(sink);
+}
+
+template <typename Cursor, typename Sink>
+void stream_debug_text(Cursor parent, Sink &&sink, size_t chunk = 64 * 1024) {
+    text_stream<Cursor>(parent, text_stream<Cursor>::debug, chunk).write_all(sink);
+}
+
+template <typename T, typename Sink>
+void stream_text(const multivector<T> &tree, Sink &&sink, size_t chunk = 64 * 1024) {
+    stream_text(tree.root(), sink, chunk);
+}
+
+template <typename T, typename Sink>
+void stream_compact(const multivector<T> &tree, Sink &&sink, size_t chunk = 64 * 1024) {
+    stream_compact(tree.root(), sink, chunk);
+}
+
+template <typename T, typename Sink>
+void stream_debug_text(const multivector<T> &tree, Sink &&sink, size_t chunk = 64 * 1024) {
+    stream_debug_text(tree.root(), sink, chunk);
+}
+
+} // namespace wythe
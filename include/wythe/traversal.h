@@ -0,0 +1,197 @@
+#pragma once
+/*
+        traversal -- Lazy coroutine traversals of multivectors.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <stop_token>
+#include <utility>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// A lazy sequence of T produced by a coroutine.  Each value is made when the
+// iterator is advanced, and lives in the coroutine frame until the next one.
+// Destroying the generator ends the coroutine wherever it was suspended.
+template <typename T> struct generator {
+    struct promise_type {
+        const T *current = nullptr;
+        std::exception_ptr error;
+
+        generator get_return_object() {
+            return generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(const T &v) noexcept {
+            current = &v;
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    struct iterator {
+        typedef std::input_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        iterator() {}
+        explicit iterator(std::coroutine_handle<promise_type> h) : h(h) {}
+
+        reference operator*() const { return *h.promise().current; }
+        pointer operator->() const { return h.promise().current; }
+
+        iterator &operator++() {
+            h.resume();
+            if (h.done() && h.promise().error)
+                std::rethrow_exception(std::exchange(h.promise().error, nullptr));
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        friend bool operator==(const iterator &i, std::default_sentinel_t) {
+            return !i.h || i.h.done();
+        }
+
+      private:
+        std::coroutine_handle<promise_type> h;
+    };
+
+    generator(generator &&b) noexcept : h(std::exchange(b.h, nullptr)) {}
+    generator &operator=(generator &&b) noexcept {
+        std::swap(h, b.h);
+        return *this;
+    }
+    ~generator() {
+        if (h)
+            h.destroy();
+    }
+
+    // starts the coroutine on the first call, after that continues where the
+    // last iterator left off
+    iterator begin() {
+        if (h && !started) {
+            started = true;
+            ++iterator(h);
+        }
+        return iterator(h);
+    }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+
+  private:
+    explicit generator(std::coroutine_handle<promise_type> h) : h(h) {}
+    std::coroutine_handle<promise_type> h;
+    bool started = false;
+};
+
+// The traversals visit the descendants of a cursor, not the cursor itself, as
+// recurse() does.  They follow the parent links of the items instead of
+// keeping a stack, so a traversal of any depth needs only the coroutine frame.
+// Each checks stop before every item and ends once a stop is requested; the
+// tree must not be mutated while a traversal is suspended.
+
+namespace detail {
+template <typename Cursor> bool last_child(const Cursor &c) { return c.it_ == &c.v->back(); }
+} // namespace detail
+
+// the descendants of top, each before its children
+template <typename Cursor>
+generator<Cursor> preorder(Cursor top, std::stop_token stop = {}) {
+    if (top.empty())
+        co_return;
+    auto c = top.begin();
+    for (;;) {
+        if (stop.stop_requested())
+            co_return;
+        co_yield c;
+        if (!c.empty()) {
+            c = c.begin();
+            continue;
+        }
+        while (detail::last_child(c)) {
+            c = c.parent();
+            if (c.it_ == top.it_)
+                co_return;
+        }
+        ++c;
+    }
+}
+
+// the descendants of top, each after its children
+template <typename Cursor>
+generator<Cursor> postorder(Cursor top, std::stop_token stop = {}) {
+    if (top.empty())
+        co_return;
+    auto c = top.begin();
+    for (;;) {
+        while (!c.empty())
+            c = c.begin();
+        if (stop.stop_requested())
+            co_return;
+        co_yield c;
+        while (detail::last_child(c)) {
+            c = c.parent();
+            if (c.it_ == top.it_ || stop.stop_requested())
+                co_return;
+            co_yield c;
+        }
+        ++c;
+    }
+}
+
+// the descendants of top in preorder with their depth, 0 for the children of
+// top, as the level of recurse()
+template <typename Cursor>
+generator<std::pair<Cursor, int>> with_depth(Cursor top, std::stop_token stop = {}) {
+    if (top.empty())
+        co_return;
+    std::pair<Cursor, int> v(top.begin(), 0);
+    auto &[c, depth] = v;
+    for (;;) {
+        if (stop.stop_requested())
+            co_return;
+        co_yield v;
+        if (!c.empty()) {
+            c = c.begin();
+            ++depth;
+            continue;
+        }
+        while (detail::last_child(c)) {
+            c = c.parent();
+            if (--depth < 0)
+                co_return;
+        }
+        ++c;
+    }
+}
+
+// the descendants of top without children, in preorder
+template <typename Cursor>
+generator<Cursor> leaves(Cursor top, std::stop_token stop = {}) {
+    if (top.empty())
+        co_return;
+    auto c = top.begin();
+    for (;;) {
+        while (!c.empty())
+            c = c.begin();
+        if (stop.stop_requested())
+            co_return;
+        co_yield c;
+        while (detail::last_child(c)) {
+            c = c.parent();
+            if (c.it_ == top.it_)
+                co_return;
+        }
+        ++c;
+    }
+}
+
+} // namespace wythe
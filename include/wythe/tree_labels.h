@@ -0,0 +1,178 @@
+#pragma once
+/*
+        tree_labels -- Euler tour labels for ancestor tests and lowest common
+        ancestors.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// Numbers the items of a tree in depth-first order.  Item i is entered at
+// number i and left after the last number of its subtree, so a is an ancestor
+// of b when entry(a) <= entry(b) <= exit(a), a constant time test.  The lowest
+// common ancestor is found by binary lifting over the same numbers, in
+// O(log depth) steps.
+//
+// The labels observe the tree.  A structural mutation only marks them stale,
+// the next query numbers the tree again; assigning values keeps them.
+// Numbers are 32 bits to halve the tables, so numbering a tree of more than
+// 2^32 - 1 items, counting the root, throws std::length_error.
+template <typename T> struct tree_labels : mutation_observer<T> {
+    typedef typename multivector<T>::cursor cursor;
+
+    explicit tree_labels(multivector<T> &tree) : tree(tree), stale(true), rebuilds_(0) {
+        tree.observe(this);
+    }
+    ~tree_labels() { tree.unobserve(this); }
+
+    tree_labels(const tree_labels &) = delete;
+    tree_labels &operator=(const tree_labels &) = delete;
+
+    // true if b is in the subtree of a, including a itself
+    template <typename Cursor> bool is_ancestor(Cursor a, Cursor b) {
+        refresh();
+        auto i = number(a), j = number(b);
+        return i <= j && j <= last[i];
+    }
+
+    // the deepest item that is an ancestor of both a and b, tree.root() if
+    // there is no other
+    template <typename Cursor> cursor lca(Cursor a, Cursor b) {
+        refresh();
+        auto i = number(a), j = number(b);
+        if (i <= j && j <= last[i])
+            return to_cursor(i);
+        for (auto k = up.size(); k-- > 0;) {
+            auto u = up[k][i];
+            if (!(u <= j && j <= last[u]))
+                i = u;
+        }
+        return to_cursor(up[0][i]);
+    }
+
+    // 0 for the root, 1 for a top level item
+    template <typename Cursor> size_t depth(Cursor c) {
+        refresh();
+        return depth_[number(c)];
+    }
+
+    // the depth-first number of c, and the last number of its subtree
+    template <typename Cursor> size_t entry(Cursor c) {
+        refresh();
+        return number(c);
+    }
+    template <typename Cursor> size_t exit(Cursor c) {
+        refresh();
+        return last[number(c)];
+    }
+
+    bool valid() const { return !stale; }
+    size_t rebuilds() const { return rebuilds_; }
+
+    void rebuild() {
+        if (tree.size() >= UINT32_MAX)
+            throw std::length_error("tree_labels: too many items for 32 bit numbers");
+        items.clear();
+        last.clear();
+        depth_.clear();
+        up.clear();
+        numbers.clear();
+        auto n = tree.size() + 1;
+        items.reserve(n);
+        last.resize(n);
+        depth_.reserve(n);
+        numbers.reserve(n);
+        std::vector<uint32_t> parent;
+        parent.reserve(n);
+
+        // depth-first, with the items entered but not yet left on a stack
+        struct frame {
+            const item_type *i;
+            size_t next;
+            uint32_t number;
+        };
+        std::vector<frame> stack;
+        auto enter = [&](const item_type *i, uint32_t p) {
+            uint32_t k = items.size();
+            numbers.emplace(i, k);
+            items.push_back(i);
+            parent.push_back(p);
+            depth_.push_back(stack.size());
+            stack.push_back(frame{i, 0, k});
+        };
+        enter(tree.root().it_, 0);
+        while (!stack.empty()) {
+            auto &f = stack.back();
+            if (f.next == f.i->nodes_.size()) {
+                last[f.number] = items.size() - 1;
+                stack.pop_back();
+            } else {
+                auto c = &f.i->nodes_[f.next++];
+                enter(c, f.number);
+            }
+        }
+
+        // up[k][i] is the ancestor 2^k levels above i, or the root
+        uint32_t height = 0;
+        for (auto d : depth_)
+            height = std::max(height, d);
+        up.push_back(std::move(parent));
+        for (size_t k = 1; (size_t(1) << k) <= height; ++k) {
+            auto &half = up[k - 1];
+            std::vector<uint32_t> next(half.size());
+            for (size_t i = 0; i < half.size(); ++i)
+                next[i] = half[half[i]];
+            up.push_back(std::move(next));
+        }
+        stale = false;
+        ++rebuilds_;
+    }
+
+    void emplaced(cursor) override { stale = true; }
+    void popping(cursor) override { stale = true; }
+    void clearing(cursor) override { stale = true; }
+    void promoting(cursor) override { stale = true; }
+    void relocating(cursor) override { stale = true; }
+    void compacting(cursor) override { stale = true; }
+    void replaced(multivector<T> &) override { stale = true; }
+
+  private:
+    typedef item<T> item_type;
+
+    void refresh() {
+        if (stale)
+            rebuild();
+    }
+
+    template <typename Cursor> uint32_t number(const Cursor &c) const {
+        auto i = numbers.find(c.it_);
+        if (i == numbers.end())
+            throw std::out_of_range("tree_labels: not an item of the tree");
+        return i->second;
+    }
+
+    cursor to_cursor(uint32_t k) {
+        auto i = const_cast<item_type *>(items[k]);
+        return i->is_root() ? tree.root() : cursor(&i->parent_item()->nodes_, i, tree.root().anchor_);
+    }
+
+    multivector<T> &tree;
+    bool stale;
+    size_t rebuilds_;
+    std::vector<const item_type *> items; // by number
+    std::vector<uint32_t> last;           // the last number in the subtree
+    std::vector<uint32_t> depth_;         // 0 for the root
+    std::vector<std::vector<uint32_t>> up;
+    std::unordered_map<const item_type *, uint32_t> numbers;
+};
+
+} // namespace wythe
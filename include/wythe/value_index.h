@@ -0,0 +1,179 @@
+#pragma once
+/*
+        value_index -- A secondary index from keys to multivector items.
+        Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+        Copyright (c) 2016-2019 Mark Beckwith <http://github.com/wythe>
+*/
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "multivector.h"
+
+namespace wythe {
+
+// Maps key(value) to the items holding the value, so find() is a hash lookup
+// rather than a scan of the tree.  The index observes the tree and follows
+// every mutation made through its cursors: emplace, pop_back, clear,
+// promote_last, compact, append and assign().  Plain *c = v is not observed,
+// the item stays under its old key; use c.assign(v) on indexed trees.
+//
+// Entries are item addresses, grouped by key, and each item knows its entry
+// so that removing or moving one does not depend on how many items share the
+// key, nor on the item's current value.  An item only moves when its sibling
+// subvector is reallocated or compacted; the cursors report that before and
+// after, and the index points its entries at the new addresses.
+template <typename T, typename Extract = std::identity,
+          typename Hash = std::hash<std::remove_cvref_t<
+              std::invoke_result_t<const Extract &, const T &>>>>
+struct value_index : mutation_observer<T> {
+    typedef typename multivector<T>::cursor cursor;
+    typedef std::remove_cvref_t<std::invoke_result_t<const Extract &, const T &>>
+        key_type;
+
+    explicit value_index(multivector<T> &tree, Extract key = Extract())
+        : tree(tree), key(std::move(key)) {
+        rebuild();
+        tree.observe(this);
+    }
+    ~value_index() { tree.unobserve(this); }
+
+    value_index(const value_index &) = delete;
+    value_index &operator=(const value_index &) = delete;
+
+    // an item with key k, or tree.end()
+    cursor find(const key_type &k) {
+        auto i = map.find(k);
+        return i == map.end() ? tree.end() : to_cursor(i->second.front());
+    }
+
+    // all items with key k, in no particular order
+    std::vector<cursor> find_all(const key_type &k) {
+        std::vector<cursor> r;
+        auto i = map.find(k);
+        if (i != map.end())
+            for (auto e : i->second)
+                r.push_back(to_cursor(e));
+        return r;
+    }
+
+    size_t count(const key_type &k) const {
+        auto i = map.find(k);
+        return i == map.end() ? 0 : i->second.size();
+    }
+    bool contains(const key_type &k) const { return map.find(k) != map.end(); }
+    size_t size() const { return where.size(); }
+
+    void rebuild() {
+        map.clear();
+        where.clear();
+        where.reserve(tree.size());
+        add_descendants(tree.root().it_);
+    }
+
+    void emplaced(cursor p) override { add(&p.it_->nodes_.back()); }
+    void popping(cursor p) override {
+        if (!p.it_->nodes_.empty())
+            remove_subtree(&p.it_->nodes_.back());
+    }
+    void clearing(cursor p) override { remove_descendants(p.it_); }
+    void promoting(cursor p) override {
+        auto &n = p.it_->nodes_;
+        if (n.empty())
+            return;
+        remove_children(&n.back());
+        remove_children(p.it_);
+    }
+    void promoted(cursor p) override { add_children(p.it_); }
+    void relocating(cursor p) override { moving = p.it_->nodes_.data(); }
+    void relocated(cursor p) override {
+        auto &n = p.it_->nodes_;
+        for (size_t k = 0; k < n.size(); ++k) {
+            auto w = where.find(moving + k);
+            if (w == where.end())
+                continue;
+            auto s = w->second;
+            where.erase(w);
+            s.group->second[s.pos] = &n[k];
+            where.emplace(&n[k], s);
+        }
+    }
+    void compacting(cursor p) override { remove_descendants(p.it_); }
+    void compacted(cursor p) override { add_descendants(p.it_); }
+    void assigning(cursor c) override { remove(c.it_); }
+    void assigned(cursor c) override { add(c.it_); }
+    void replaced(multivector<T> &) override { rebuild(); }
+
+  private:
+    typedef item<T> item_type;
+
+    cursor to_cursor(item_type *i) {
+        return cursor(&i->parent_item()->nodes_, i, tree.root().anchor_);
+    }
+
+    typedef std::unordered_map<key_type, std::vector<item_type *>, Hash> map_type;
+    typedef typename map_type::value_type group_type;
+
+    // where an item's entry is: its key's group, which does not move when the
+    // map rehashes, and the position in it
+    struct slot {
+        group_type *group;
+        size_t pos;
+    };
+
+    void add(item_type *i) {
+        auto &g = *map.try_emplace(key(i->value)).first;
+        g.second.push_back(i);
+        where[i] = slot{&g, g.second.size() - 1};
+    }
+
+    // remove the entry of item i, if it has one, by moving the last entry of
+    // its group into its place
+    void remove(item_type *i) {
+        auto w = where.find(i);
+        if (w == where.end())
+            return;
+        auto s = w->second;
+        where.erase(w);
+        auto &v = s.group->second;
+        if (s.pos + 1 != v.size()) {
+            v[s.pos] = v.back();
+            where[v[s.pos]].pos = s.pos;
+        }
+        v.pop_back();
+        if (v.empty())
+            map.erase(map.find(s.group->first));
+    }
+
+    void add_children(item_type *p) {
+        for (auto &i : p->nodes_)
+            add(&i);
+    }
+    void remove_children(item_type *p) {
+        for (auto &i : p->nodes_)
+            remove(&i);
+    }
+    void add_descendants(item_type *p) {
+        for (auto &i : p->nodes_) {
+            add(&i);
+            add_descendants(&i);
+        }
+    }
+    void remove_descendants(item_type *p) {
+        for (auto &i : p->nodes_)
+            remove_subtree(&i);
+    }
+    void remove_subtree(item_type *i) {
+        remove(i);
+        remove_descendants(i);
+    }
+
+    multivector<T> &tree;
+    Extract key;
+    map_type map;
+    std::unordered_map<item_type *, slot> where;
+    item_type *moving = nullptr; // the children's address before relocation
+};
+
+} // namespace wythe
@@ -1,7 +1,31 @@
 #include "multivectorunit.h"
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
 #include <string>
+#include <thread>
+#include <wythe/aggregate.h>
+#include <wythe/concurrent_children.h>
+#include <wythe/journal.h>
+#include <wythe/json.h>
+#include <wythe/lazy_multivector.h>
 #include <wythe/multivector.h>
+#include <wythe/multivector_view.h>
+#include <wythe/parallel_builder.h>
+#include <wythe/parallel_serialize.h>
+#include <wythe/partitioned.h>
+#include <wythe/selector.h>
+#include <wythe/serialize.h>
+#include <wythe/shared_multivector.h>
+#include <wythe/string_multivector.h>
+#include <wythe/text_stream.h>
+#include <wythe/traversal.h>
+#include <wythe/tree_labels.h>
+#include <wythe/value_index.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 void multivector_unit::empty_multivectors() {
     // default constructor
@@ -74,7 +98,7 @@ void size_one_test(const wythe::multivector<int> & x) {
     IT_ASSERT(x.size() == 1);
     IT_ASSERT(!x.root().empty());
     IT_ASSERT(x.root().size() == 1);
-    IT_ASSERT(x.root()[0] == 42);
+    IT_ASSERT(x.root().child(0) == 42);
     IT_ASSERT(*x.root().begin() == 42);
     IT_ASSERT(x.root().begin().empty());
 }
@@ -129,9 +153,9 @@ void size_two_test(std::string m, wythe::multivector<int> & x) {
     IT_ASSERT_MSG(m, !x.root().empty());
     IT_ASSERT_MSG(m, x.root().size() == 1);
     IT_ASSERT_MSG(m, x.root().begin().size() == 1);
-    IT_ASSERT_MSG(m, x.root()[0] == 42);
-    IT_ASSERT_MSG(m, x.root().begin()[0] == 43);
-    IT_ASSERT_MSG(m, x.root().begin()[0] == 43);
+    IT_ASSERT_MSG(m, x.root().child(0) == 42);
+    IT_ASSERT_MSG(m, x.root().begin().child(0) == 43);
+    IT_ASSERT_MSG(m, x.root().begin().child(0) == 43);
     IT_ASSERT_MSG(m, !x.root().begin().empty());
     IT_ASSERT_MSG(m, x.root().begin().begin().empty());
     IT_ASSERT_MSG(m, x.root().begin().begin().empty());
@@ -220,7 +244,7 @@ void multivector_unit::complicated() {
     IT_ASSERT_MSG(x, x ==
     "3 {2 {1 {0}}} 3 {2 {1 {0}}} 3 {2 {1 {0}}} 33 {34 {35}} 1 {4 {0 1} 5 {0 1} 6 {0 1}} 2 {7 {0 1} 8 {0 1} 9 {0 1}} 3 {10 {0 1} 11 {0 1} 12 {0 1}}");
 
-    c.root()[0] = 1;
+    c.root().child(0) = 1;
 
     x = wythe::compact_string(c);
     IT_ASSERT_MSG(x, x ==
@@ -476,6 +500,1762 @@ void multivector_unit::append_children() {
     IT_ASSERT(q == s);
 }
 
+// counts the special member calls of a value type
+struct counted {
+    static int defaults, copies, moves, assigns;
+    static void reset() { defaults = copies = moves = assigns = 0; }
+
+    counted() : n(0) { ++defaults; }
+    explicit counted(int n) : n(n) {}
+    counted(const counted & b) : n(b.n) { ++copies; }
+    counted(counted && b) noexcept : n(b.n) { ++moves; }
+    counted & operator=(const counted & b) { n = b.n; ++assigns; return *this; }
+    counted & operator=(counted && b) noexcept { n = b.n; ++assigns; return *this; }
+    bool operator==(const counted & b) const { return n == b.n; }
+    int n;
+};
+
+int counted::defaults = 0;
+int counted::copies = 0;
+int counted::moves = 0;
+int counted::assigns = 0;
+
+void multivector_unit::in_place() {
+    wythe::multivector<counted> a;
+    for (int i = 0; i < 5; ++i) {
+        auto c = a.root().emplace(i);
+        for (int j = 0; j < 3; ++j) c.emplace_back(j);
+    }
+    IT_ASSERT(a.size() == 20);
+
+    // copying constructs each value exactly once, no default construction or assignment
+    counted::reset();
+    wythe::multivector<counted> b(a);
+    IT_ASSERT(b == a);
+    IT_ASSERT_MSG(counted::copies, counted::copies == 21); // including the root
+    IT_ASSERT_MSG(counted::defaults, counted::defaults == 0);
+    IT_ASSERT_MSG(counted::assigns, counted::assigns == 0);
+
+    // moving copies nothing
+    counted::reset();
+    wythe::multivector<counted> c(std::move(b));
+    IT_ASSERT(c == a);
+    IT_ASSERT(counted::copies == 0);
+    IT_ASSERT(counted::defaults == 0);
+    IT_ASSERT(counted::assigns == 0);
+
+    // converting a cursor copies only the children and value initializes the root
+    counted::reset();
+    wythe::multivector<counted> d(a.begin());
+    IT_ASSERT(d.size() == 3);
+    IT_ASSERT_MSG(counted::copies, counted::copies == 3);
+    IT_ASSERT(counted::defaults == 1);
+    IT_ASSERT(counted::assigns == 0);
+
+    // promote_last moves the children up
+    counted::reset();
+    a.root().promote_last();
+    wythe::verify(a);
+    IT_ASSERT(a.size() == 19);
+    IT_ASSERT(counted::copies == 0);
+    IT_ASSERT(counted::assigns == 0);
+}
+
+struct no_default {
+    explicit no_default(int n) : n(n) {}
+    int n;
+};
+
+void multivector_unit::move_only() {
+    typedef wythe::multivector<std::unique_ptr<int>> ptr_multivector;
+    ptr_multivector a;
+    IT_ASSERT(!*a.root());
+    auto c = a.root().emplace(new int(1));
+    c.emplace_back(new int(10));
+    c.emplace_back(std::unique_ptr<int>(new int(11)));
+    a.root().emplace_back(new int(2));
+    IT_ASSERT(a.size() == 4);
+    IT_ASSERT(**a.begin() == 1);
+    IT_ASSERT(**(a.begin().begin() + 1) == 11);
+
+    // force reallocation of the top level
+    for (int i = 3; i < 100; ++i) a.root().emplace_back(new int(i));
+    wythe::verify(a);
+    IT_ASSERT(**(a.begin().begin() + 1) == 11);
+
+    ptr_multivector b(std::move(a));
+    IT_ASSERT(a.empty());
+    IT_ASSERT(b.size() == 101);
+    wythe::verify(b);
+
+    a = std::move(b);
+    *(a.begin() + 1).item_ptr() = std::unique_ptr<int>(new int(42));
+    IT_ASSERT(**(a.begin() + 1) == 42);
+
+    a.root().promote_last();
+    a.root().pop_back();
+    a.root().item_ref().insert_parent();
+    wythe::verify(a);
+    IT_ASSERT(a.root().size() == 1);
+    IT_ASSERT(a.begin().size() == 97);
+
+    // the root value can be constructed in place for types without a default constructor
+    wythe::multivector<no_default> n(wythe::root_value, 7);
+    IT_ASSERT(n.root()->n == 7);
+    n.root().emplace(8).emplace(9);
+    auto m = n;
+    IT_ASSERT(m.root()->n == 7);
+    IT_ASSERT(m.begin().begin()->n == 9);
+}
+
+void multivector_unit::interned() {
+    auto a = wythe::string_multivector{ "record", { "name", "crc", "name", { "a", "b" } }, "record" };
+    IT_ASSERT(sizeof(wythe::interned_string) == 4);
+    IT_ASSERT(a.size() == 7);
+    IT_ASSERT_MSG(wythe::compact_string(a), wythe::compact_string(a) == "record {name crc name {a b}} record");
+    IT_ASSERT(wythe::to_text(a) == "record\n  name\n  crc\n  name\n    a\n    b\nrecord\n");
+
+    // repeated strings share an id
+    auto r = a.begin();
+    IT_ASSERT(r->id() == (a.begin() + 1)->id());
+    IT_ASSERT(r.begin()->id() == (r.begin() + 2)->id());
+    IT_ASSERT(*r == "record");
+    IT_ASSERT(*r == std::string("record"));
+    IT_ASSERT(r->str() == "record");
+    IT_ASSERT(wythe::interned_string().empty());
+    IT_ASSERT(a.root()->empty());
+
+    // equality and ordering match multivector<std::string>
+    auto b = wythe::string_multivector{ "record", { "name", "crc", "name", { "a", "b" } }, "record" };
+    auto c = wythe::string_multivector{ "record", { "name", "crc", "name", { "a", "c" } }, "record" };
+    IT_ASSERT(a == b);
+    IT_ASSERT(a != c);
+    IT_ASSERT(a < c);
+    IT_ASSERT(c > a);
+    IT_ASSERT(wythe::string_multivector{ "b" } > wythe::string_multivector{ "a" });
+    IT_ASSERT(wythe::string_multivector{ "zz_interned_first" } > wythe::string_multivector{ "aa_interned_last" });
+
+    // mutation through a cursor
+    *r.begin() = "title";
+    IT_ASSERT(wythe::compact_string(a) == "record {title crc name {a b}} record");
+    IT_ASSERT(a != b);
+
+    // strings are read without a lock while other threads intern more
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&, t] {
+            std::vector<wythe::interned_string> mine;
+            for (int i = 0; i < 2000; ++i) {
+                auto s = "thread " + std::to_string(t) + " " + std::to_string(i);
+                mine.emplace_back(s);
+                if (mine.back() != s || mine[i / 2] != mine[i / 2].str() || *r != "record")
+                    ok = false;
+            }
+        });
+    for (auto &t : threads)
+        t.join();
+    IT_ASSERT(ok);
+}
+
+template <typename Cursor>
+bool fits(Cursor parent) {
+    if (parent.item_ref().nodes_.capacity() != parent.size()) return false;
+    for (auto i = parent.begin(); i != parent.end(); ++i)
+        if (!fits(i)) return false;
+    return true;
+}
+
+void multivector_unit::compacting() {
+    auto a = create_complicated();
+    a.root().emplace_back(99);
+    a.root().pop_back();
+    a.begin().clear();
+    IT_ASSERT(!fits(a.root()));
+    auto b = a;
+
+    size_t slack = 0;
+    wythe::recurse(a.root(), [&](wythe::multivector<int>::cursor c) {
+        slack += c.item_ref().nodes_.capacity() - c.size();
+    });
+    slack += a.root().item_ref().nodes_.capacity() - a.root().size();
+
+    auto reclaimed = a.compact();
+    IT_ASSERT_MSG(reclaimed, reclaimed == slack * sizeof(a.root_));
+    IT_ASSERT(fits(a.root()));
+    IT_ASSERT(a == b);
+    wythe::verify(a);
+    IT_ASSERT(compact_string(a) == compact_string(b));
+    IT_ASSERT(a.compact() == 0);
+
+    // cursor form only touches the subtree
+    auto c = b.begin() + 4;
+    c.emplace_back(100);
+    c.pop_back();
+    IT_ASSERT(!fits(c));
+    IT_ASSERT(wythe::compact(c) > 0);
+    IT_ASSERT(fits(c));
+    IT_ASSERT(a == b);
+    wythe::verify(b);
+
+    wythe::multivector<int> e;
+    IT_ASSERT(e.compact() == 0);
+}
+
+namespace wythe {
+template <> struct codec<Custom> {
+    template <typename Sink> static void write(Sink & sink, const Custom & c) {
+        codec<std::string>::write(sink, c.name);
+        codec<int>::write(sink, c.length);
+        codec<uint64_t>::write(sink, c.value);
+        codec<std::string>::write(sink, c.description);
+    }
+    template <typename Source> static Custom read(Source & source) {
+        Custom c;
+        c.name = codec<std::string>::read(source);
+        c.length = codec<int>::read(source);
+        c.value = codec<uint64_t>::read(source);
+        c.description = codec<std::string>::read(source);
+        return c;
+    }
+};
+}
+
+// a sink whose writes fail
+struct failing_sink {
+    void write(const char *, size_t) { throw std::runtime_error("failing_sink"); }
+};
+
+// true if w, writing to a failing_sink, throws its error
+template <typename Write> bool write_fails(Write w) {
+    try {
+        w(failing_sink());
+    } catch (std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+void multivector_unit::binary() {
+    {
+        auto a = create_complicated();
+        auto s = wythe::serialize(a);
+        auto b = wythe::deserialize<int>(wythe::memory_source(s));
+        IT_ASSERT(a == b);
+        IT_ASSERT(fits(b.root()));
+        wythe::verify(b);
+
+        // a subtree becomes the root
+        std::string t;
+        wythe::serialize(a.begin() + 3, wythe::string_sink(t));
+        auto c = wythe::deserialize<int>(wythe::memory_source(t));
+        IT_ASSERT(*c.root() == 33);
+        IT_ASSERT_MSG(compact_string(c), compact_string(c) == "34 {35}");
+
+        // truncated input throws
+        bool thrown = false;
+        try {
+            wythe::deserialize<int>(wythe::memory_source(s.data(), s.data() + s.size() - 1));
+        } catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT(thrown);
+        thrown = false;
+        try {
+            wythe::deserialize<int>(wythe::memory_source(std::string("junk and more junk")));
+        } catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT(thrown);
+
+        // a corrupt count throws at the end of input rather than reserving it
+        for (bool nested : {false, true}) {
+            std::string h = "mvb\1";
+            wythe::string_sink sink(h);
+            for (int i = 0; i < 2; ++i) {
+                wythe::codec<int>::write(sink, 1);
+                wythe::write_varint(sink, nested && !i ? 1 : uint64_t(1) << 40);
+                if (!nested)
+                    break;
+            }
+            thrown = false;
+            try { wythe::deserialize<int>(wythe::memory_source(h)); }
+            catch (std::runtime_error &) { thrown = true; }
+            IT_ASSERT(thrown);
+            thrown = false;
+            std::stringstream ss(h);
+            try { wythe::deserialize<int>(wythe::istream_source(ss)); }
+            catch (std::runtime_error &) { thrown = true; }
+            IT_ASSERT(thrown);
+        }
+
+        wythe::multivector<int> e;
+        IT_ASSERT(wythe::deserialize<int>(wythe::memory_source(wythe::serialize(e))) == e);
+
+        // an error writing the last buffer is thrown, not raised in a destructor
+        IT_ASSERT(write_fails([&](failing_sink f) { wythe::serialize(a, f); }));
+    }
+    {
+        auto a = wythe::multivector<std::string>{ "a", { "", "ccc", { "x" } }, "d" };
+        *(a.begin().begin() + 1).begin() = std::string(300, 'x');
+        std::stringstream ss;
+        wythe::serialize(a, wythe::ostream_sink(ss));
+        auto b = wythe::deserialize<std::string>(wythe::istream_source(ss));
+        IT_ASSERT(a == b);
+    }
+    {
+        // deep trees do not recurse
+        wythe::multivector<int> a;
+        auto c = a.root();
+        for (int i = 0; i < 10000; ++i) c = c.emplace(i);
+        auto b = wythe::deserialize<int>(wythe::memory_source(wythe::serialize(a)));
+        IT_ASSERT(a.size() == b.size());
+        IT_ASSERT(*b.begin() == 0);
+    }
+    {
+        wythe::multivector<Custom> a;
+        auto i = a.root().emplace(Custom{"record", 5, 5, "0"});
+        i.emplace_back(Custom{"bar", 1, 6, "a"});
+        i.emplace_back(Custom{"goo", 8, 23, "b"});
+        a.root().emplace_back(Custom{"crc", 80, 5555555, "d"});
+        auto b = wythe::deserialize<Custom>(wythe::memory_source(wythe::serialize(a)));
+        IT_ASSERT(b.size() == 4);
+        IT_ASSERT((b.begin() + 1)->value == 5555555);
+        IT_ASSERT((b.begin().begin() + 1)->description == "b");
+    }
+}
+
+void multivector_unit::view() {
+    {
+        auto a = create_complicated();
+        std::string s;
+        wythe::write_view(a, wythe::string_sink(s));
+        wythe::multivector_view<int> v(s.data(), s.size());
+        IT_ASSERT(v.size() == a.size());
+        IT_ASSERT(!v.empty());
+        IT_ASSERT(v.root().size() == 7);
+        IT_ASSERT(wythe::compact_string(v) == wythe::compact_string(a));
+        IT_ASSERT(wythe::to_text(v) == wythe::to_text(a));
+
+        // navigation
+        auto c = v.begin() + 4;
+        IT_ASSERT(*c == 1);
+        IT_ASSERT(c.size() == 3);
+        IT_ASSERT(c.child(1) == 5 && v.begin()[4] == 1 && c.begin()[2] == 6);
+        IT_ASSERT(*(c.begin() + 2).begin() == 0);
+        IT_ASSERT((c.begin() + 2).begin().parent() == c.begin() + 2);
+        IT_ASSERT(c.begin().parent() == c);
+        IT_ASSERT(c.parent() == v.root());
+        IT_ASSERT(c.parent().is_root());
+        IT_ASSERT(v.end() - v.begin() == 7);
+        IT_ASSERT(v.end() != (v.begin() + 0).begin()); // end of one subvector is not the next
+        IT_ASSERT((c.begin() + 1).begin().empty());
+
+        // linear traversal matches the multivector
+        IT_ASSERT(std::equal(wythe::to_linear(v.begin()), wythe::to_linear(v.end()),
+                             wythe::to_linear(a.cbegin())));
+        std::vector<int> x(wythe::to_linear(c.begin()), wythe::to_linear(c.end()));
+        IT_ASSERT(x == (std::vector<int>{4, 0, 1, 5, 0, 1, 6, 0, 1}));
+
+        // wrong value type
+        bool thrown = false;
+        try { wythe::multivector_view<char> w(s.data(), s.size()); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT(thrown);
+
+        IT_ASSERT(write_fails([&](failing_sink f) { wythe::write_view(a, f); }));
+
+        // items out of range are found when the view is opened
+        auto items = sizeof(wythe::view_header);
+        auto corrupt = [&](size_t item, size_t field, uint64_t value) {
+            std::string t = s;
+            memcpy(&t[items + item * sizeof(wythe::view_item) + field * sizeof(uint64_t)],
+                   &value, sizeof(value));
+            try { wythe::multivector_view<int> w(t.data(), t.size()); }
+            catch (std::runtime_error &) { return true; }
+            return false;
+        };
+        IT_ASSERT(!corrupt(5, 0, 0));          // the parent it already has
+        IT_ASSERT(corrupt(0, 0, 3));           // a root with a parent
+        IT_ASSERT(corrupt(5, 0, 6));           // a parent after the item
+        IT_ASSERT(corrupt(5, 1, 1u << 30));    // children past the end
+        IT_ASSERT(corrupt(0, 2, a.size() + 1)); // too many children
+        IT_ASSERT(corrupt(5, 1, 1));           // another item's children
+        IT_ASSERT(corrupt(5, 2, uint64_t(-1)));
+
+        // so are arrays at misaligned offsets
+        auto misaligned = [&](std::initializer_list<size_t> fields) {
+            std::string t = s + std::string(4, '\0');
+            for (auto f : fields) {
+                uint64_t v;
+                memcpy(&v, &t[f], sizeof(v));
+                v += f == offsetof(wythe::view_header, items) ? -4 : 4;
+                memcpy(&t[f], &v, sizeof(v));
+            }
+            try { wythe::multivector_view<int> w(t.data(), t.size()); }
+            catch (std::runtime_error &) { return true; }
+            return false;
+        };
+        IT_ASSERT(misaligned({offsetof(wythe::view_header, items)}));
+        IT_ASSERT(misaligned({offsetof(wythe::view_header, values),
+                              offsetof(wythe::view_header, blob),
+                              offsetof(wythe::view_header, bytes)}));
+        IT_ASSERT(!misaligned({}));
+    }
+    {
+        auto a = wythe::multivector<std::string>{ "a", { "", "ccc", { "x" } }, "d" };
+        std::string name = "multivector_view_test.mvv";
+        {
+            std::ofstream f(name, std::ios::binary);
+            wythe::write_view(a, wythe::ostream_sink(f));
+        }
+        auto v = wythe::multivector_view<std::string>::open(name);
+        std::remove(name.c_str());
+        IT_ASSERT(wythe::compact_string(v) == "a { ccc {x}} d");
+        IT_ASSERT(*(v.begin().begin() + 1).begin() == "x");
+        IT_ASSERT(wythe::to_text(v) == wythe::to_text(a));
+
+        std::string t;
+        wythe::write_view(a, wythe::string_sink(t));
+        auto values = reinterpret_cast<const wythe::view_header *>(t.data())->values;
+        t[values + 3] = 1; // the first string's offset, far past the blob
+        bool thrown = false;
+        try { wythe::multivector_view<std::string> w(t.data(), t.size()); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT(thrown);
+
+        wythe::multivector<std::string> e;
+        std::string s;
+        wythe::write_view(e, wythe::string_sink(s));
+        wythe::multivector_view<std::string> w(s.data(), s.size());
+        IT_ASSERT(w.empty());
+        IT_ASSERT(w.begin() == w.end());
+        IT_ASSERT(wythe::compact_string(w) == "");
+    }
+}
+
+void multivector_unit::parsing() {
+    {
+        auto a = create_complicated();
+        auto s = wythe::compact_string(a);
+        auto b = wythe::parse_compact<int>(s);
+        IT_ASSERT(a == b);
+        IT_ASSERT(fits(b.root()));
+        wythe::verify(b);
+
+        // any chunking gives the same tree
+        for (size_t n : {1, 2, 3, 7}) {
+            wythe::compact_parser<int> p;
+            for (size_t i = 0; i < s.size(); i += n) p.feed(std::string_view(s).substr(i, n));
+            IT_ASSERT(p.finish() == a);
+        }
+
+        std::istringstream is(s);
+        IT_ASSERT(wythe::parse_compact<int>(is) == a);
+    }
+    {
+        auto a = wythe::parse_compact<int>("  1 2{4 5 6 {7 8 9}}\n5 {7} -3 ");
+        IT_ASSERT_MSG(wythe::compact_string(a), wythe::compact_string(a) == "1 2 {4 5 6 {7 8 9}} 5 {7} -3");
+        IT_ASSERT(wythe::parse_compact<int>("").empty());
+        IT_ASSERT(wythe::parse_compact<int>(" ").empty());
+
+        auto s = wythe::parse_compact<std::string>("record {name crc {a b}} record");
+        IT_ASSERT(s == (wythe::multivector<std::string>{ "record", { "name", "crc", { "a", "b" } }, "record" }));
+
+        auto d = wythe::parse_compact<double>("1.5 {2.25 -3e2}");
+        IT_ASSERT(*d.begin() == 1.5);
+        IT_ASSERT(*(d.begin().begin() + 1) == -300);
+    }
+    for (auto bad : {"1 {2", "1 }", "{1}", "1 {2} {3}", "1 {{2}}", "x"}) {
+        bool thrown = false;
+        try { wythe::parse_compact<int>(bad); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT_MSG(bad, thrown);
+    }
+}
+
+void multivector_unit::writers() {
+    auto a = wythe::multivector<int>{ 1, 2, {4, 5, 6, {7, 8, 9}}, 5, {7}, 3 };
+
+    // appends to a reusable buffer
+    std::string buf = "> ";
+    wythe::write_compact(a.root(), buf);
+    IT_ASSERT_MSG(buf, buf == "> 1 2 {4 5 6 {7 8 9}} 5 {7} 3");
+    buf.clear();
+    wythe::write_text(a.begin() + 1, buf);
+    IT_ASSERT_MSG(buf, buf == "4\n5\n6\n  7\n  8\n  9\n");
+
+    // or to an output iterator
+    std::vector<char> v;
+    wythe::write_compact(a.root(), std::back_inserter(v));
+    IT_ASSERT(std::string(v.begin(), v.end()) == wythe::compact_string(a));
+    std::ostringstream os;
+    wythe::write_text(a.root(), std::ostreambuf_iterator<char>(os));
+    IT_ASSERT(os.str() == wythe::to_text(a));
+
+    // the text writer can be driven one item at a time
+    wythe::text_writer<wythe::multivector<int>::const_cursor> w(a.root(), w.compact);
+    std::string s;
+    int n = 0;
+    while (w.next(s)) ++n;
+    IT_ASSERT(n == 11);
+    IT_ASSERT(w.done());
+    IT_ASSERT(s == "1 2 {4 5 6 {7 8 9}} 5 {7} 3");
+
+    IT_ASSERT(wythe::compact_string(wythe::multivector<int>()) == "");
+    IT_ASSERT(wythe::compact_string(wythe::multivector<int>{ 1, { 2, { 3 } } }) == "1 {2 {3}}");
+    IT_ASSERT(wythe::to_text(wythe::multivector<int>()) == "");
+
+    // numbers round trip exactly
+    auto d = wythe::multivector<double>{ 0.1, { 1.0 / 3, -2.5e-300 } };
+    IT_ASSERT_MSG(wythe::compact_string(d), wythe::compact_string(d) == "0.1 {0.3333333333333333 -2.5e-300}");
+    IT_ASSERT(wythe::parse_compact<double>(wythe::compact_string(d)) == d);
+
+    // other types still use operator<<
+    wythe::multivector<boo> b;
+    b.root().emplace(1, "@1", "mark").emplace(2, "@2", "allan");
+    IT_ASSERT_MSG(wythe::compact_string(b), wythe::compact_string(b) == "1 @1 mark {2 @2 allan}");
+
+    auto i = wythe::string_multivector{ "record", { "name", "crc" } };
+    IT_ASSERT(wythe::compact_string(i) == "record {name crc}");
+    IT_ASSERT(wythe::parse_compact<wythe::interned_string>("record {name crc}") == i);
+}
+
+void multivector_unit::streaming() {
+    typedef wythe::multivector<int>::const_cursor const_cursor;
+    auto a = create_complicated();
+    const wythe::multivector<int> & c = a;
+
+    std::ostringstream os;
+    wythe::stream_text(a, wythe::ostream_sink(os), 16);
+    IT_ASSERT(os.str() == wythe::to_text(a));
+    os.str("");
+    wythe::stream_compact(a, wythe::ostream_sink(os));
+    IT_ASSERT(os.str() == wythe::compact_string(a));
+
+    // resumable in small pieces through a small buffer
+    wythe::text_stream<const_cursor> s(c.root(), s.compact, 16);
+    std::string out;
+    wythe::string_sink sink(out);
+    size_t n;
+    while ((n = s.write_some(sink, 7)) != 0) IT_ASSERT(n <= 7);
+    IT_ASSERT(s.done());
+    IT_ASSERT_MSG(out, out == wythe::compact_string(a));
+
+    wythe::text_stream<const_cursor> r(c.root(), r.table, 1);
+    char buf[5];
+    out.clear();
+    while ((n = r.read(buf, sizeof(buf))) != 0) out.append(buf, n);
+    IT_ASSERT(out == wythe::to_text(a));
+
+    // debug text has the parent pointer of every item
+    auto d = wythe::to_debug_text(a);
+    IT_ASSERT(std::count(d.begin(), d.end(), '\n') == 46);
+    IT_ASSERT_MSG(d.substr(0, 21), d.substr(0, 21) == "0 0xffffffffffffffff\n");
+    IT_ASSERT(d.find("\n3 0x") != std::string::npos);
+    IT_ASSERT(d.find("\n3 0\n") != std::string::npos);
+
+    // FILE and file descriptor sinks
+    FILE *f = tmpfile();
+    wythe::stream_debug_text(a, wythe::file_sink(f));
+    rewind(f);
+    std::string fromfile;
+    int ch;
+    while ((ch = fgetc(f)) != EOF) fromfile += char(ch);
+    fclose(f);
+    IT_ASSERT(fromfile == d);
+
+    int fds[2];
+    IT_ASSERT(pipe(fds) == 0);
+    wythe::stream_compact(a.begin() + 4, wythe::fd_sink(fds[1]), 4);
+    close(fds[1]);
+    out.clear();
+    while ((n = ::read(fds[0], buf, sizeof(buf))) > 0) out.append(buf, n);
+    close(fds[0]);
+    IT_ASSERT_MSG(out, out == "4 {0 1} 5 {0 1} 6 {0 1}");
+}
+
+// records builder events
+struct json_events {
+    void value(wythe::json_node &&n) { os << n << ';'; }
+    void start_children() { os << '('; }
+    void end_children() { os << ')'; }
+    std::ostringstream os;
+};
+
+void multivector_unit::json() {
+    typedef wythe::json_node json_node;
+    const char *text = R"({"a": 1, "b": [true, null, "x\"y"], "c": {}, "d": -2.5e3})";
+    {
+        json_events e;
+        wythe::json_parser<json_events> p(e);
+        p.feed(text);
+        p.finish();
+        IT_ASSERT_MSG(e.os.str(), e.os.str() ==
+            "{};(a: 1;b: [];(true;null;\"x\"y\";)c: {};()d: -2.5e3;)");
+    }
+
+    auto a = wythe::parse_json(text);
+    IT_ASSERT(a.size() == 8);
+    IT_ASSERT(a.root().size() == 1);
+    auto o = a.begin();
+    IT_ASSERT(o->kind == json_node::object);
+    IT_ASSERT(o.size() == 4);
+    IT_ASSERT((o.begin() + 1)->key == "b");
+    IT_ASSERT((o.begin() + 1).size() == 3);
+    IT_ASSERT(((o.begin() + 1).begin())->as_bool());
+    IT_ASSERT((o.begin() + 3)->as_number() == -2500);
+    IT_ASSERT(fits(a.root()));
+
+    // the same tree when fed one character at a time
+    {
+        wythe::tree_builder<json_node> b;
+        wythe::json_parser<wythe::tree_builder<json_node>> p(b);
+        for (const char *c = text; *c; ++c) p.feed(std::string_view(c, 1));
+        p.finish();
+        IT_ASSERT(b.finish() == a);
+    }
+
+    // escapes, top level sequences and streams
+    auto u = wythe::parse_json("\"\\u00e9\\ud83d\\ude00\\n\" 1 [] [2]");
+    IT_ASSERT(u.root().size() == 4);
+    IT_ASSERT(u.begin()->text == "\xc3\xa9\xf0\x9f\x98\x80\n");
+    IT_ASSERT((u.begin() + 3).size() == 1);
+    std::istringstream is(text);
+    IT_ASSERT(wythe::parse_json(is) == a);
+
+    for (auto bad : {"{", "[1,]", "{\"a\" 1}", "{1: 2}", "[1 2]", "tru", "01x", "\"abc",
+                     "[}", "\"\\q\"", "1,2"}) {
+        bool thrown = false;
+        try { wythe::parse_json(bad); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT_MSG(bad, thrown);
+    }
+}
+
+// counts the events reported to a mutation_observer
+struct event_counter : wythe::mutation_observer<int> {
+    void emplaced(cursor) override { ++n[0]; }
+    void popping(cursor) override { ++n[1]; }
+    void clearing(cursor) override { ++n[2]; }
+    void promoting(cursor) override { ++n[3]; }
+    void assigned(cursor) override { ++n[4]; }
+    void replaced(wythe::multivector<int> &) override { ++n[5]; }
+    int n[6] = {};
+};
+
+void multivector_unit::journal() {
+    {
+        auto a = create_complicated();
+        event_counter e;
+        a.observe(&e);
+        a.emplace_back(1);
+        a.begin().emplace(2).emplace_back(3);
+        (a.begin() + 3).pop_back();
+        (a.begin() + 1).clear();
+        a.begin().promote_last();
+        (a.begin() + 2).assign(7);
+        *(a.begin() + 2) = 8; // not observed
+        a = create_complicated();
+        IT_ASSERT(e.n[0] == 3 && e.n[1] == 1 && e.n[2] == 1 && e.n[3] == 1 && e.n[4] == 1 &&
+                  e.n[5] == 1);
+        a.unobserve(&e);
+        a.emplace_back(1);
+        IT_ASSERT(e.n[0] == 3);
+        IT_ASSERT(a.begin().begin().tree() == &a);
+    }
+    {
+        // cursors find their tree after it moves, including by reallocation
+        std::vector<wythe::multivector<int>> trees(1, create_complicated());
+        auto c = trees[0].begin() + 2;
+        trees.resize(10);
+        event_counter e;
+        trees[0].observe(&e);
+        c.emplace_back(5);
+        c.pop_back();
+        IT_ASSERT(e.n[0] == 1 && e.n[1] == 1 && c.tree() == &trees[0]);
+        wythe::multivector<int> moved(std::move(trees[0]));
+        c.emplace_back(5);
+        IT_ASSERT(e.n[0] == 1 && c.tree() == &moved);
+        trees[0].unobserve(&e);
+        IT_ASSERT(!wythe::multivector<int>::observed_trees);
+
+        // cursors from root() carry the tree's anchor, which moves with it;
+        // others find the tree through the root
+        IT_ASSERT(c.anchor_ && trees[0].root().anchor_ != c.anchor_);
+        trees[1] = std::move(moved);
+        IT_ASSERT(c.tree() == &trees[1] && moved.root().tree() == &moved);
+        auto pre = wythe::to_precursor(trees[1].begin() + 2);
+        wythe::multivector<int>::cursor d(pre);
+        IT_ASSERT(!d.anchor_ && d.tree() == &trees[1]);
+        trees[1].observe(&e);
+        d.emplace_back(6);
+        IT_ASSERT(e.n[0] == 2);
+        trees[1].unobserve(&e);
+    }
+
+    std::string name = "multivector_journal_test";
+    auto cleanup = [&] {
+        std::remove(name.c_str());
+        std::remove((name + ".checkpoint").c_str());
+    };
+    cleanup();
+
+    // a new journal checkpoints the tree first
+    auto a = create_complicated();
+    auto expected = a;
+    {
+        wythe::mutation_journal<int> j(a, name);
+        IT_ASSERT(j.records() == 0);
+        auto c = a.begin() + 3;
+        c.emplace_back(100);
+        c.emplace(101).emplace_back(102);
+        (c.begin() + 1).assign(-5);
+        (a.begin() + 1).pop_back();
+        a.begin().clear();
+        (a.begin() + 6).promote_last();
+        a.emplace_back(9);
+        IT_ASSERT(j.records() == 8);
+    }
+    IT_ASSERT(wythe::replay<int>(name) == a);
+    IT_ASSERT(wythe::replay<int>(name) != expected);
+
+    // continue the journal, then checkpoint, which truncates it
+    auto b = wythe::replay<int>(name);
+    {
+        wythe::mutation_journal<int> j(b, name);
+        b.pop_back();
+        b.begin().emplace_back(1);
+        j.flush();
+        IT_ASSERT(wythe::replay<int>(name) == b);
+        j.checkpoint();
+        IT_ASSERT(j.records() == 0);
+        b.begin().emplace_back(2);
+    }
+    IT_ASSERT(wythe::replay<int>(name) == b);
+
+    // a torn record is ignored
+    {
+        FILE *f = fopen(name.c_str(), "ab");
+        fwrite("\x09\x01", 1, 2, f);
+        fclose(f);
+    }
+    IT_ASSERT(wythe::replay<int>(name) == b);
+
+    // a crash after a checkpoint's rename leaves the previous journal, which
+    // is not continued
+    std::string old;
+    {
+        std::ifstream in(name, std::ios::binary);
+        old.assign(std::istreambuf_iterator<char>(in), {});
+        wythe::mutation_journal<int> j(b, name);
+        j.checkpoint();
+    }
+    {
+        std::ofstream out(name, std::ios::binary);
+        out << old;
+    }
+    b = wythe::replay<int>(name);
+    {
+        wythe::mutation_journal<int> j(b, name);
+        b.begin().emplace_back(3);
+    }
+    IT_ASSERT(wythe::replay<int>(name) == b);
+
+    // a failed checkpoint in a whole tree assignment is retried by the next record
+    std::string dir = "multivector_journal_dir";
+    mkdir(dir.c_str(), 0700);
+    {
+        wythe::multivector<int> c;
+        wythe::mutation_journal<int> j(c, dir + "/j");
+        std::remove((dir + "/j").c_str());
+        std::remove((dir + "/j.checkpoint").c_str());
+        rmdir(dir.c_str());
+        c = create_complicated();
+        bool thrown = false;
+        try { j.flush(); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT(thrown);
+        mkdir(dir.c_str(), 0700);
+        c.begin().emplace_back(4);
+        IT_ASSERT(j.records() == 0);
+        c.begin().pop_back();
+        IT_ASSERT(j.records() == 1);
+        j.flush();
+        IT_ASSERT(wythe::replay<int>(dir + "/j") == c);
+    }
+    std::remove((dir + "/j").c_str());
+    std::remove((dir + "/j.checkpoint").c_str());
+    rmdir(dir.c_str());
+
+    cleanup();
+    IT_ASSERT(wythe::replay<int>(name).empty());
+}
+
+void multivector_unit::lazy() {
+    auto a = create_complicated();
+    std::string name = "multivector_lazy_test.mvv";
+    {
+        std::ofstream f(name, std::ios::binary);
+        wythe::write_view(a, wythe::ostream_sink(f));
+    }
+    {
+        // opening reads nothing but the header
+        auto v = wythe::lazy_multivector<int>::open(name, 2);
+        IT_ASSERT(v.loads() == 0);
+        IT_ASSERT(v.size() == a.size());
+        auto c = (v.begin() + 4).begin() + 1;
+        IT_ASSERT(*c == *((a.begin() + 4).begin() + 1));
+        IT_ASSERT(c.parent() == v.begin() + 4);
+        IT_ASSERT(c.parent().parent().is_root());
+        IT_ASSERT(v.resident() <= 2);
+
+        // algorithms work unchanged, loading at most two subvectors at a time
+        IT_ASSERT(wythe::compact_string(v) == wythe::compact_string(a));
+        IT_ASSERT(wythe::to_text(v) == wythe::to_text(a));
+        IT_ASSERT(v.resident() == 2);
+        size_t n = 0;
+        wythe::recurse(v.root(), [&](wythe::lazy_cursor<int>) { ++n; });
+        IT_ASSERT(n == a.size());
+        wythe::multivector<int> b;
+        wythe::append(b.root(), v.root());
+        IT_ASSERT(b == a);
+        n = 0;
+        for (auto l = wythe::to_linear(v.begin()); l != wythe::to_linear(v.end()); ++l) ++n;
+        IT_ASSERT(n == a.size());
+    }
+    {
+        auto s = wythe::multivector<std::string>{"html", {"head", {"title"}, "body"}, ""};
+        std::ofstream f(name, std::ios::binary);
+        wythe::write_view(s, wythe::ostream_sink(f));
+        f.close();
+        auto v = wythe::lazy_multivector<std::string>::open(name);
+        IT_ASSERT(*v.begin().begin() == "head");
+        IT_ASSERT(*(v.begin().begin() + 1) == "body");
+        IT_ASSERT(*(v.begin() + 1) == "");
+        IT_ASSERT(wythe::compact_string(v) == wythe::compact_string(s));
+
+        // a string before the run of its subvector, though within the blob
+        std::string t;
+        wythe::write_view(s, wythe::string_sink(t));
+        uint64_t zero = 0;
+        auto values = reinterpret_cast<const wythe::view_header *>(t.data())->values;
+        memcpy(&t[values + 4 * 2 * sizeof(uint64_t)], &zero, sizeof(zero)); // "body"
+        f.open(name, std::ios::binary);
+        f << t;
+        f.close();
+        bool thrown = false;
+        try { wythe::compact_string(wythe::lazy_multivector<std::string>::open(name)); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT(thrown);
+    }
+    {
+        // a corrupt file throws when the damaged subvector is read
+        std::string s;
+        wythe::write_view(a, wythe::string_sink(s));
+        auto corrupt = [&](size_t offset, uint64_t value) {
+            std::string t = s;
+            memcpy(&t[offset], &value, sizeof(value));
+            {
+                std::ofstream f(name, std::ios::binary);
+                f << t;
+            }
+            try { wythe::compact_string(wythe::lazy_multivector<int>::open(name, 2)); }
+            catch (std::runtime_error &) { return true; }
+            return false;
+        };
+        auto item = [](size_t item, size_t field) {
+            return sizeof(wythe::view_header) + item * sizeof(wythe::view_item) +
+                   field * sizeof(uint64_t);
+        };
+        IT_ASSERT(!corrupt(item(5, 0), 0));          // the parent it already has
+        IT_ASSERT(corrupt(item(0, 0), 3));           // a root with a parent
+        IT_ASSERT(corrupt(item(5, 0), 6));           // a parent after the item
+        IT_ASSERT(corrupt(item(5, 1), 1u << 30));    // children past the end
+        IT_ASSERT(corrupt(item(0, 2), a.size() + 1)); // too many children
+        IT_ASSERT(corrupt(item(5, 1), 1));           // another item's children
+        IT_ASSERT(corrupt(item(5, 2), uint64_t(-1)));
+        IT_ASSERT(corrupt(offsetof(wythe::view_header, count), uint64_t(1) << 40));
+        IT_ASSERT(corrupt(offsetof(wythe::view_header, bytes), s.size() + 1));
+    }
+    std::remove(name.c_str());
+}
+
+// every child's parent() is the item it is under
+template <typename Cursor> bool linked(Cursor parent) {
+    for (auto c = parent.begin(); c != parent.end(); ++c)
+        if (c.parent() != parent || !linked(c))
+            return false;
+    return true;
+}
+
+void multivector_unit::parallel_binary() {
+    wythe::multivector<int> wide, deep;
+    for (int i = 0; i < 1000; ++i) wide.emplace_back(i);
+    auto c = deep.root();
+    for (int i = 0; i < 1000; ++i) c = c.emplace(i);
+    auto big = wythe::multivector<int>{};
+    for (int i = 0; i < 20; ++i) {
+        auto x = big.root().emplace(i);
+        for (int j = 0; j < i; ++j) {
+            auto y = x.emplace(j);
+            for (int k = 0; k < j % 5; ++k) y.emplace(k);
+        }
+    }
+    for (auto *tree : {&wide, &deep, &big}) {
+        auto a = create_complicated();
+        for (auto &t : {a, *tree, wythe::multivector<int>()}) {
+            for (unsigned threads : {1, 2, 3, 8}) {
+                std::string s;
+                wythe::parallel_serialize(t, wythe::string_sink(s), threads);
+                auto b = wythe::parallel_deserialize<int>(s, threads);
+                IT_ASSERT(b == t);
+                IT_ASSERT(fits(b.root()));
+                IT_ASSERT(linked(b.root()));
+                std::string s2;
+                wythe::parallel_serialize(b, wythe::string_sink(s2), threads);
+                IT_ASSERT(s2 == s);
+            }
+        }
+    }
+
+    auto m = wythe::multivector<std::string>{"html", {"head", {"title"}, "body"}, "x"};
+    std::string s;
+    wythe::parallel_serialize(m, wythe::string_sink(s), 4);
+    IT_ASSERT(wythe::parallel_deserialize<std::string>(s) == m);
+    IT_ASSERT(write_fails([&](failing_sink f) { wythe::parallel_serialize(m, f, 4); }));
+
+    // while another tree of the same type is observed
+    {
+        auto other = create_complicated();
+        wythe::path_cache<int> cache(other);
+        std::string u;
+        wythe::parallel_serialize(big, wythe::string_sink(u), 2);
+        IT_ASSERT(wythe::parallel_deserialize<int>(u, 2) == big);
+    }
+
+    std::string t;
+    wythe::parallel_serialize(big, wythe::string_sink(t), 4);
+    for (size_t n : {size_t(0), size_t(3), t.size() / 2, t.size() - 1}) {
+        bool thrown = false;
+        try { wythe::parallel_deserialize<int>(t.data(), n, 4); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT_MSG(n, thrown);
+    }
+
+    // a corrupt count in the skeleton is not reserved
+    std::string h = "mvc\1";
+    wythe::string_sink sink(h);
+    wythe::write_varint(sink, 1);
+    wythe::codec<int>::write(sink, 1);
+    wythe::write_varint(sink, uint64_t(1) << 40);
+    bool thrown = false;
+    try { wythe::parallel_deserialize<int>(h, 2); }
+    catch (std::runtime_error &) { thrown = true; }
+    IT_ASSERT(thrown);
+}
+
+void multivector_unit::paths() {
+    typedef wythe::multivector<int>::cursor cursor;
+    auto a = create_complicated();
+    IT_ASSERT(wythe::navigate(a.root(), 4, 1, 0) == ((a.begin() + 4).begin() + 1).begin());
+    IT_ASSERT(wythe::navigate(a.root()) == a.root());
+    const size_t p[] = {3, 0, 0};
+    IT_ASSERT(*wythe::at_path(a.root(), std::span<const size_t>(p)) == 35);
+    IT_ASSERT(*wythe::at_path(a.begin() + 3, {0, 0}) == 35);
+    for (auto bad : {std::vector<size_t>{7}, {3, 1}, {3, 0, 0, 0}}) {
+        bool thrown = false;
+        try { wythe::at_path(a.root(), std::span<const size_t>(bad)); }
+        catch (std::out_of_range &) { thrown = true; }
+        IT_ASSERT(thrown);
+    }
+
+    // path_of and at_path are inverses, after changes that move siblings
+    a.begin().promote_last();
+    (a.begin() + 5).item_ref().insert_parent();
+    IT_ASSERT(linked(a.root()));
+    size_t n = 0;
+    wythe::recurse(a.root(), [&](cursor c) {
+        IT_ASSERT(wythe::at_path(a.root(), std::span<const size_t>(wythe::path_of(c))) == c);
+        ++n;
+    });
+    IT_ASSERT(n == a.size());
+    IT_ASSERT(wythe::path_of(a.root()).empty());
+    IT_ASSERT((wythe::path_of((a.begin() + 4).begin() + 2) == std::vector<size_t>{4, 2}));
+
+    // the cache is cleared by structural changes, not by values
+    wythe::path_cache<int> cache(a);
+    IT_ASSERT(*cache.at({3, 0}) == 34);
+    IT_ASSERT(*cache.at({3, 0}) == 34);
+    IT_ASSERT(cache.hits() == 1 && cache.misses() == 1);
+    cache.at({3, 0}).assign(-34);
+    IT_ASSERT(*cache.at({3, 0}) == -34);
+    IT_ASSERT(cache.hits() == 3);
+    a.begin().emplace_back(9);
+    IT_ASSERT(*cache.at({3, 0}) == -34);
+    IT_ASSERT(cache.misses() == 2);
+    a.compact();
+    IT_ASSERT(cache.at({3, 0}) == (a.begin() + 3).begin());
+    IT_ASSERT(cache.misses() == 3);
+}
+
+// the index holds exactly one entry per item, each leading back to its item
+template <typename Index, typename Tree> bool indexes(Index &index, Tree &a) {
+    bool ok = index.size() == a.size();
+    wythe::recurse(a.root(), [&](typename Tree::cursor c) {
+        auto all = index.find_all(*c);
+        ok = ok && std::count(all.begin(), all.end(), c) == 1;
+    });
+    return ok;
+}
+
+struct record {
+    std::string name;
+    int length;
+};
+
+void multivector_unit::value_indexing() {
+    auto a = create_complicated();
+    wythe::value_index<int> index(a);
+    IT_ASSERT(indexes(index, a));
+    size_t threes = 0;
+    wythe::recurse(a.root(), [&](wythe::multivector<int>::cursor c) { threes += *c == 3; });
+    IT_ASSERT(index.count(3) == threes && threes == 4);
+    IT_ASSERT(*index.find(35) == 35 && index.find(35).parent() == (a.begin() + 3).begin());
+    IT_ASSERT(index.find(-1) == a.end() && !index.contains(-1));
+
+    // every observed mutation keeps the index exact, including emplaces that
+    // reallocate the siblings of indexed items
+    auto c = a.begin() + 4;
+    for (int i = 0; i < 100; ++i)
+        c.emplace_back(1000 + i);
+    c.emplace(2000).emplace_back(2001);
+    IT_ASSERT(indexes(index, a));
+    c.reserve(1000);
+    IT_ASSERT(indexes(index, a) && *index.find(1050) == 1050);
+    IT_ASSERT(index.find(1050) == c.begin() + 53);
+    c.pop_back();
+    IT_ASSERT(!index.contains(2000) && !index.contains(2001));
+    (a.begin() + 3).begin().assign(-34);
+    IT_ASSERT(!index.contains(34) && *index.find(-34) == -34);
+    a.begin().promote_last();
+    IT_ASSERT(indexes(index, a));
+    (a.begin() + 1).clear();
+    IT_ASSERT(indexes(index, a));
+    wythe::append(a.begin() + 2, (a.begin() + 4).begin(), (a.begin() + 4).end());
+    IT_ASSERT(indexes(index, a));
+    a.compact();
+    IT_ASSERT(indexes(index, a));
+    auto copied = index.find_all(1050);
+    IT_ASSERT(copied.size() == 2);
+    IT_ASSERT(std::count(copied.begin(), copied.end(), (a.begin() + 4).begin() + 53) == 1);
+    a = create_complicated();
+    IT_ASSERT(indexes(index, a) && !index.contains(1050));
+    a.clear();
+    IT_ASSERT(index.size() == 0);
+
+    // an unobserved *c = v leaves the item under its old key, which still
+    // follows it when its siblings move
+    auto d = a.root().emplace(7);
+    *d = 8;
+    for (int i = 0; i < 100; ++i)
+        a.emplace_back(1000 + i);
+    IT_ASSERT(index.find(7) == a.begin() && !index.contains(8));
+    d = a.begin();
+    d.assign(9);
+    IT_ASSERT(!index.contains(7) && index.find(9) == a.begin());
+    a.clear();
+
+    // many items under one key
+    for (int i = 0; i < 40000; ++i)
+        a.emplace_back(5);
+    IT_ASSERT(index.count(5) == 40000);
+    for (int i = 0; i < 20000; ++i)
+        a.root().pop_back();
+    IT_ASSERT(index.count(5) == 20000 && index.size() == 20000);
+    a.clear();
+    IT_ASSERT(index.size() == 0 && !index.contains(5));
+
+    // records keyed by name
+    wythe::multivector<record> r;
+    auto by_name = [](const record &x) -> const std::string & { return x.name; };
+    wythe::value_index<record, decltype(by_name)> names(r, by_name);
+    for (int i = 0; i < 10; ++i) {
+        auto p = r.root().emplace(record{"p" + std::to_string(i), i});
+        for (int j = 0; j < 10; ++j)
+            p.emplace_back(record{"c" + std::to_string(i * 10 + j), j});
+    }
+    IT_ASSERT(names.size() == 110);
+    IT_ASSERT(names.find("c42")->length == 2 && names.find("c42").parent()->name == "p4");
+    names.find("c42").assign(record{"renamed", 0});
+    IT_ASSERT(!names.contains("c42") && names.count("renamed") == 1);
+}
+
+void multivector_unit::labels() {
+    typedef wythe::multivector<int>::cursor cursor;
+    auto a = create_complicated();
+    wythe::tree_labels<int> labels(a);
+    IT_ASSERT(!labels.valid());
+
+    // compare with the parent() chain for every pair
+    std::vector<cursor> all{a.root()};
+    wythe::recurse(a.root(), [&](cursor c) { all.push_back(c); });
+    auto ancestor = [](cursor x, cursor y) {
+        for (;; y = y.parent()) {
+            if (x == y) return true;
+            if (y.is_root()) return false;
+        }
+    };
+    auto depth = [](cursor c) {
+        size_t d = 0;
+        for (; !c.is_root(); c = c.parent()) ++d;
+        return d;
+    };
+    for (auto x : all)
+        for (auto y : all) {
+            IT_ASSERT(labels.is_ancestor(x, y) == ancestor(x, y));
+            auto l = labels.lca(x, y);
+            IT_ASSERT(ancestor(l, x) && ancestor(l, y));
+            IT_ASSERT(l == x || l == y || (!ancestor(x, y) && !ancestor(y, x)));
+        }
+    IT_ASSERT(labels.rebuilds() == 1);
+    for (auto x : all)
+        IT_ASSERT(labels.depth(x) == depth(x));
+    IT_ASSERT(labels.entry(a.root()) == 0 && labels.exit(a.root()) == a.size());
+
+    auto x = (a.begin() + 4).begin() + 1;
+    IT_ASSERT(labels.lca(x.begin(), ((a.begin() + 4).begin() + 2).begin()) == a.begin() + 4);
+    IT_ASSERT(labels.lca(x.begin(), a.begin().begin()) == a.root());
+
+    // values do not invalidate the labels, structure does
+    x.assign(-5);
+    IT_ASSERT(labels.valid());
+    x.emplace_back(99);
+    IT_ASSERT(!labels.valid());
+    IT_ASSERT(labels.is_ancestor(a.begin() + 4, x.begin() + 2));
+    IT_ASSERT(labels.rebuilds() == 2);
+    (a.begin() + 4).pop_back();
+    IT_ASSERT(labels.depth((a.begin() + 3).begin().begin()) == 3);
+
+    bool thrown = false;
+    try { labels.is_ancestor(a.root(), a.end()); }
+    catch (std::out_of_range &) { thrown = true; }
+    IT_ASSERT(thrown);
+}
+
+void multivector_unit::roots() {
+    wythe::multivector<int> a;
+    auto c = a.root();
+    for (int i = 0; i < 1000; ++i) {
+        c.emplace_back(i);
+        c = c.end() - 1;
+    }
+    IT_ASSERT(wythe::get_root(c) == a.root());
+    IT_ASSERT(c.anchor_ == a.root().anchor_ && c.tree() == &a); // constant time
+    const auto &ca = a;
+    IT_ASSERT(wythe::get_root(ca.begin().begin()) == ca.root());
+
+    // a cursor made from a precursor finds its tree too
+    auto pc = wythe::to_precursor(c);
+    wythe::multivector<int>::cursor d(pc);
+    IT_ASSERT(d.tree() == &a && wythe::get_root(d).item_ptr() == a.root().item_ptr());
+
+    auto b = create_complicated();
+    auto copy = b;
+    IT_ASSERT(wythe::same_tree(b.begin() + 3, (b.begin() + 4).begin()));
+    IT_ASSERT(wythe::same_tree(d, a.begin()) && wythe::same_tree(ca.root(), c));
+    IT_ASSERT(!wythe::same_tree(b.begin(), copy.begin()) && !wythe::same_tree(d, b.root()));
+    IT_ASSERT(b.begin() != copy.begin());
+
+    // verify reports a broken link
+    wythe::verify(b);
+    auto &i = ((b.begin() + 4).begin() + 2).item_ref();
+    auto saved = i.parent;
+    i.parent = wythe::item<int>::sibling_tag(1);
+    bool thrown = false;
+    try { wythe::verify(b); }
+    catch (std::runtime_error &) { thrown = true; }
+    IT_ASSERT(thrown);
+    i.parent = saved;
+    wythe::verify(b);
+
+    // after a move, cursors lead to the new root
+    auto e = b.begin() + 4;
+    auto moved = std::move(b);
+    IT_ASSERT(wythe::get_root(e) == moved.root() && e.tree() == &moved);
+    IT_ASSERT(wythe::same_tree(e, moved.begin()) && !wythe::same_tree(e, b.root()));
+    wythe::verify(moved);
+    wythe::multivector<int> assigned;
+    assigned = std::move(moved);
+    IT_ASSERT(wythe::get_root(e) == assigned.root() && e.tree() == &assigned);
+    IT_ASSERT(wythe::same_tree(e, assigned.begin()) && !wythe::same_tree(e, moved.root()));
+    wythe::verify(assigned);
+}
+
+void multivector_unit::selectors() {
+    typedef wythe::multivector<int>::cursor cursor;
+    auto a = create_complicated();
+    // "3 {2 {1 {0}}} 3 {2 {1 {0}}} 3 {2 {1 {0}}} 33 {34 {35}} 1 {4 {0 1} 5 {0 1} 6 {0 1}} ..."
+    auto values = [](const std::vector<cursor> &v) {
+        std::vector<int> r;
+        for (auto c : v) r.push_back(*c);
+        return r;
+    };
+    auto query = [&](const char *q) {
+        return values(wythe::selector<int>(q).select(a.root()).to_vector());
+    };
+    IT_ASSERT((query("3") == std::vector<int>{3, 3, 3, 3}));
+    IT_ASSERT((query("3/2") == std::vector<int>{2, 2, 2}));
+    IT_ASSERT((query("//1") == std::vector<int>{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}));
+    IT_ASSERT((query("//34/35") == std::vector<int>{35}));
+    IT_ASSERT((query("/*[3]//*") == std::vector<int>{34, 35}));
+    IT_ASSERT((query("*[4]/*/*[1]") == std::vector<int>{1, 1, 1}));
+    IT_ASSERT((query("//2//0") == std::vector<int>(6, 0)));
+    IT_ASSERT(query("//*").size() == a.size());
+    IT_ASSERT(query("//*/*/*/*").size() == 3);
+
+    // the same matches, in the same order, as recurse lambdas
+    std::vector<cursor> expected;
+    for (auto t = a.begin(); t != a.end(); ++t)
+        if (*t < 5)
+            wythe::recurse(t, [&](cursor c) { if (*c > 5) expected.push_back(c); });
+    wythe::selector<int> big("/*[?small]//*[?big]",
+                             {{"small", [](int v) { return v < 5; }}, {"big", [](int v) { return v > 5; }}});
+    std::vector<cursor> got;
+    for (auto c : wythe::select(a.root(), big)) got.push_back(c);
+    IT_ASSERT(got == expected && got.size() == 7);
+
+    // a compiled selector runs on const trees and on subtrees
+    const auto &ca = a;
+    IT_ASSERT(big.select(ca.root()).count() == 7);
+    IT_ASSERT(big.select(a.begin() + 5).count() == 0);
+    IT_ASSERT(wythe::selector<int>("*").select(a.begin() + 5).count() == 3);
+
+    // records matched by name
+    auto s = wythe::parse_compact<std::string>("record {crc len} x {record {len crc {crc}} a/b}");
+    auto crcs = wythe::selector<std::string>("//record/crc").select(s.root()).to_vector();
+    IT_ASSERT(crcs.size() == 2 && crcs[1].parent().parent() == s.begin() + 1);
+    IT_ASSERT(wythe::selector<std::string>("x/\"a/b\"").select(s.root()).count() == 1);
+
+    for (auto bad : {"", "1//", "1[", "1[x]", "1[?nope]", "\"open", "1 2/3]", "x"}) {
+        bool thrown = false;
+        try { wythe::selector<int>(bad).select(a.root()).count(); }
+        catch (std::runtime_error &) { thrown = true; }
+        IT_ASSERT_MSG(bad, thrown);
+    }
+}
+
+void multivector_unit::sorted_children() {
+    typedef wythe::multivector<int>::cursor cursor;
+    static_assert(std::random_access_iterator<cursor>);
+    static_assert(std::random_access_iterator<wythe::multivector<int>::const_cursor>);
+    static_assert(std::is_same<cursor::difference_type, std::ptrdiff_t>::value);
+
+    wythe::multivector<int> a;
+    auto p = a.root().emplace(0);
+    for (int i = 0; i < 1000; ++i)
+        p.emplace_back(2 * i);
+    IT_ASSERT(p.end() - p.begin() == 1000 && p.begin() < p.end() && p.end() - 1 >= p.begin());
+    IT_ASSERT(p.begin()[3] == 6 && (p.end() - 1)[-2] == 1994 && p.child(3) == 6);
+    IT_ASSERT(std::ranges::subrange(p.begin(), p.end())[1] == 2);
+    IT_ASSERT(*std::lower_bound(p.begin(), p.end(), 501) == 502);
+    IT_ASSERT(wythe::lower_bound_child(p, 501) == p.begin() + 251);
+    IT_ASSERT(wythe::lower_bound_child(p, 5000) == p.end());
+    IT_ASSERT(wythe::find_child_sorted(p, 998) == p.begin() + 499);
+    IT_ASSERT(wythe::find_child_sorted(p, 999) == p.end());
+    IT_ASSERT(wythe::find_child_sorted(a.root(), 0) == a.begin());
+    const auto &ca = a;
+    IT_ASSERT(*wythe::find_child_sorted(ca.begin(), 4) == 4);
+
+    // descending order, and records by a member
+    for (auto c = p.begin(); c != p.end(); ++c)
+        *c = -*c;
+    IT_ASSERT(wythe::find_child_sorted(p, -6, std::ranges::greater()) == p.begin() + 3);
+    wythe::multivector<record> r;
+    for (int i = 0; i < 100; ++i)
+        r.root().emplace_back(record{"k" + std::to_string(1000 + i), i});
+    auto k = wythe::find_child_sorted(r.root(), std::string("k1042"), {}, &record::name);
+    IT_ASSERT(k != r.end() && k->length == 42);
+    IT_ASSERT(wythe::find_child_sorted(r.root(), std::string("k"), {}, &record::name) == r.end());
+}
+
+// every cached aggregate equals one computed by recurse
+template <typename Aggregate, typename Monoid>
+bool aggregates(Aggregate &agg, wythe::multivector<int> &a, Monoid m) {
+    typedef wythe::multivector<int>::cursor cursor;
+    bool ok = true;
+    auto check = [&](cursor c) {
+        auto x = c.is_root() ? m.identity() : m.of(*c);
+        wythe::recurse(c, [&](cursor d) { x = m.combine(x, m.of(*d)); });
+        ok = ok && agg.aggregate(c) == x;
+    };
+    check(a.root());
+    wythe::recurse(a.root(), check);
+    return ok;
+}
+
+void multivector_unit::subtree_aggregates() {
+    auto a = create_complicated();
+    wythe::sum_monoid<long> sum;
+    wythe::max_monoid<int> max;
+    wythe::subtree_aggregate total(a, sum);
+    wythe::subtree_aggregate highest(a, max);
+    IT_ASSERT(total.total() == 207 && aggregates(total, a, sum));
+    IT_ASSERT(highest.aggregate(a.begin() + 4) == 6 && highest.total() == 35);
+
+    // mutations, including emplaces that reallocate siblings
+    auto c = a.begin() + 4;
+    for (int i = 0; i < 40; ++i)
+        c.begin().emplace_back(i);
+    c.emplace(100).emplace_back(-7);
+    IT_ASSERT(highest.aggregate(c) == 100 && highest.total() == 100);
+    (c.end() - 1).assign(1);
+    IT_ASSERT(highest.aggregate(c) == 39 && aggregates(total, a, sum) && aggregates(highest, a, max));
+    c.pop_back();
+    c.begin().pop_back();
+    IT_ASSERT(highest.aggregate(c) == 38 && aggregates(total, a, sum) && aggregates(highest, a, max));
+    (a.begin() + 3).promote_last();
+    a.begin().promote_last();
+    IT_ASSERT(aggregates(total, a, sum) && aggregates(highest, a, max));
+    (a.begin() + 3).clear();
+    c.begin().clear();
+    IT_ASSERT(highest.total() == 33 && aggregates(total, a, sum) && aggregates(highest, a, max));
+    wythe::append(a.begin() + 1, (a.begin() + 5).begin(), (a.begin() + 5).end());
+    a.compact();
+    IT_ASSERT(aggregates(total, a, sum) && aggregates(highest, a, max));
+    a = create_complicated();
+    IT_ASSERT(aggregates(total, a, sum) && highest.total() == 35);
+    a.clear();
+    IT_ASSERT(total.total() == 0 && highest.total() == std::numeric_limits<int>::lowest());
+
+    // records, summed by a member
+    wythe::multivector<record> r;
+    wythe::subtree_aggregate bytes(r, wythe::sum_monoid<size_t, int record::*>{&record::length});
+    auto p = r.root().emplace(record{"dir", 0});
+    p.emplace_back(record{"a", 10});
+    p.emplace(record{"sub", 0}).emplace_back(record{"b", 32});
+    IT_ASSERT(bytes.aggregate(p) == 42 && bytes.aggregate(p.begin() + 1) == 32);
+    bool thrown = false;
+    try { bytes.aggregate(p.end()); }
+    catch (std::out_of_range &) { thrown = true; }
+    IT_ASSERT(thrown);
+}
+
+void multivector_unit::snapshots() {
+    // every update appends the same value to each top level item, so a
+    // consistent snapshot has top level items of equal size
+    wythe::multivector<int> start;
+    for (int i = 0; i < 4; ++i)
+        start.emplace_back(i);
+    wythe::shared_multivector<int> shared(start, 8);
+    const int updates = 2000;
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0}, reads{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+        readers.emplace_back([&] {
+            auto r = shared.make_reader();
+            while (!done.load()) {
+                auto s = r.read();
+                auto root = s.root();
+                for (auto c = root.begin(); c != root.end(); ++c)
+                    if (c.size() != s.seq() || (!c.empty() && *(c.end() - 1) != int(s.seq()) - 1))
+                        ++torn;
+                ++reads;
+            }
+        });
+    for (int i = 0; i < updates; ++i) {
+        shared.update([i](wythe::multivector<int> &t) {
+            for (auto c = t.begin(); c != t.end(); ++c)
+                c.emplace_back(i);
+        });
+        if (i % 3 == 2)
+            shared.publish();
+    }
+    shared.publish();
+    while (reads.load() < 100)
+        std::this_thread::yield();
+    done = true;
+    for (auto &t : readers)
+        t.join();
+    IT_ASSERT(torn == 0);
+
+    auto r = shared.make_reader();
+    {
+        auto s = r.read();
+        IT_ASSERT(s.seq() == updates && s.tree().size() == 4 * (updates + 1));
+        // a pinned version is unchanged by later writes
+        shared.write([](wythe::multivector<int> &t) { t.emplace_back(-1); });
+        shared.write([](wythe::multivector<int> &t) { t.emplace_back(-2); });
+        IT_ASSERT(s.root().size() == 4 && s.seq() == updates);
+    }
+    IT_ASSERT(r.read().root().size() == 6);
+    for (int i = 0; i < 10; ++i)
+        shared.write([](wythe::multivector<int> &t) { t.begin().pop_back(); });
+    IT_ASSERT(shared.versions() <= 3 + 1);
+
+    std::vector<wythe::shared_multivector<int>::reader> all;
+    bool thrown = false;
+    try {
+        while (true)
+            all.push_back(shared.make_reader());
+    } catch (std::runtime_error &) { thrown = true; }
+    IT_ASSERT(thrown && all.size() == 7);
+}
+
+// grow a subtree with edits that reallocate, pop, promote and compact
+static void churn(wythe::multivector<int>::cursor c, int seed) {
+    for (int i = 0; i < 2000; ++i) {
+        auto k = c.emplace(seed + i);
+        for (int j = 0; j < i % 5; ++j)
+            k.emplace_back(j);
+        if (i % 7 == 6)
+            c.pop_back();
+        if (i % 11 == 10)
+            c.promote_last();
+        if (i % 101 == 100)
+            c.compact();
+        if (!c.empty())
+            c.begin().assign(seed);
+    }
+}
+
+void multivector_unit::partitions() {
+    const int n = 8;
+    wythe::multivector<int> a, expected;
+    for (int i = 0; i < n; ++i) {
+        a.emplace_back(i);
+        expected.emplace_back(i);
+        churn(expected.begin() + i, i * 10000);
+    }
+    {
+        wythe::partitioned<int> parts(a.root());
+        std::vector<std::thread> threads;
+        for (int i = 0; i < n; ++i)
+            threads.emplace_back([&, i] { churn(parts[i], i * 10000); });
+        for (auto &t : threads)
+            t.join();
+        IT_ASSERT(parts.intact() && parts.size() == n);
+    }
+    wythe::verify(a);
+    IT_ASSERT(linked(a.root()));
+    IT_ASSERT(a == expected);
+
+    // threads sharing partitions take their locks
+    wythe::partitioned<int> parts(a.root());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 1000; ++i)
+                parts.with((t + i) % 2, [&](wythe::multivector<int>::cursor c) { c.emplace_back(-1); });
+        });
+    for (auto &t : threads)
+        t.join();
+    IT_ASSERT(a.begin().size() + (a.begin() + 1).size() ==
+              expected.begin().size() + (expected.begin() + 1).size() + 4000);
+    a.emplace_back(99);
+    IT_ASSERT(!parts.intact());
+
+    event_counter e;
+    a.observe(&e);
+    bool thrown = false;
+    try { wythe::partitioned<int> observed(a.root()); }
+    catch (std::logic_error &) { thrown = true; }
+    IT_ASSERT(thrown);
+    a.unobserve(&e);
+}
+
+void multivector_unit::concurrent_appends() {
+    const int producers = 8, n = 5000;
+    wythe::multivector<int> a;
+    a.emplace_back(-1);
+    a.begin().emplace_back(-2);
+    wythe::concurrent_children<int> kids[2];
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; ++t)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < n; ++i)
+                kids[t % 2].emplace_back(t * n + i);
+        });
+    for (auto &t : threads)
+        t.join();
+    IT_ASSERT(kids[0].size() + kids[1].size() == producers * n);
+    kids[0].seal(a.begin());
+    kids[1].seal(a.root());
+    IT_ASSERT(kids[0].size() == 0 && kids[1].size() == 0);
+    wythe::verify(a);
+    IT_ASSERT(linked(a.root()));
+
+    // every value once, each producer's in its order, after the old children
+    IT_ASSERT(a.begin().size() == 1 + producers / 2 * n);
+    IT_ASSERT(a.root().size() == 1 + producers / 2 * n);
+    IT_ASSERT(*a.begin().begin() == -2);
+    std::vector<int> last(producers, -1);
+    size_t seen = 0;
+    for (auto p : {a.begin(), a.root()})
+        for (auto c = p.begin(); c != p.end(); ++c) {
+            if (*c < 0)
+                continue;
+            auto t = *c / n;
+            IT_ASSERT(t % 2 == (p == a.root()) && *c % n == last[t] + 1);
+            last[t] = *c % n;
+            IT_ASSERT(c.empty());
+            ++seen;
+        }
+    IT_ASSERT(seen == producers * n);
+
+    // values that were never sealed are destroyed
+    auto shared = std::make_shared<int>(7);
+    {
+        wythe::concurrent_children<std::shared_ptr<int>> s;
+        for (int i = 0; i < 200; ++i)
+            s.emplace_back(shared);
+        IT_ASSERT(shared.use_count() == 201);
+    }
+    IT_ASSERT(shared.use_count() == 1);
+
+    // a value whose constructor throws leaves its index empty, neither
+    // sealed nor destroyed
+    struct fragile {
+        fragile() : v(-1) {}
+        fragile(int v, std::shared_ptr<int> p) : v(v), p(std::move(p)) {
+            if (v % 3 == 0)
+                throw std::runtime_error("fragile");
+        }
+        int v;
+        std::shared_ptr<int> p;
+    };
+    {
+        wythe::concurrent_children<fragile> f;
+        std::atomic<int> thrown(0);
+        threads.clear();
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([&, t] {
+                for (int i = t; i < 400; i += 4)
+                    try { f.emplace_back(i, shared); }
+                    catch (std::runtime_error &) { ++thrown; }
+            });
+        for (auto &t : threads)
+            t.join();
+        IT_ASSERT(thrown == 134 && f.size() == 266);
+        IT_ASSERT(shared.use_count() == 267);
+        wythe::multivector<fragile> d;
+        f.seal(d.root());
+        IT_ASSERT(d.size() == 266 && f.size() == 0);
+        IT_ASSERT(std::none_of(d.begin(), d.end(), [](auto &x) { return x.v % 3 == 0; }));
+        IT_ASSERT(shared.use_count() == 267);
+        for (int i = 1; i < 100; ++i)
+            try { f.emplace_back(i, shared); }
+            catch (std::runtime_error &) {}
+    }
+    IT_ASSERT(shared.use_count() == 1);
+
+    wythe::multivector<std::string> b;
+    wythe::concurrent_children<std::string> names;
+    names.emplace_back("x");
+    names.emplace_back(3, 'y');
+    names.seal(b.root());
+    IT_ASSERT(b.size() == 2 && *b.begin() == "x" && *(b.begin() + 1) == "yyy");
+
+    // sealing into an indexed tree moves the indexed children
+    wythe::multivector<int> c;
+    wythe::value_index<int> index(c);
+    for (int i = 0; i < 10; ++i)
+        c.emplace_back(i);
+    wythe::concurrent_children<int> more;
+    for (int i = 10; i < 1000; ++i)
+        more.emplace_back(i);
+    more.seal(c.root());
+    IT_ASSERT(*index.find(5) == 5 && index.find(5) == c.begin() + 5);
+    IT_ASSERT(index.size() == 1000 && indexes(index, c));
+}
+
+void multivector_unit::traversals() {
+    typedef wythe::multivector<int>::cursor cursor;
+    auto a = create_complicated();
+    a.begin().emplace(50).emplace(51).emplace(52);
+
+    // the same items, in the same order, as recurse
+    for (auto top : {a.root(), a.begin(), a.begin() + 1, a.end() - 1}) {
+        std::vector<cursor> pre, post, leaf, got;
+        std::vector<int> levels, depths;
+        wythe::recurse(top, [&](cursor c, int level) {
+            pre.push_back(c);
+            levels.push_back(level);
+            if (c.empty())
+                leaf.push_back(c);
+        }, [&](cursor c, int) { post.push_back(c); });
+
+        for (auto c : wythe::preorder(top))
+            got.push_back(c);
+        IT_ASSERT(got == pre);
+        got.clear();
+        for (auto c : wythe::postorder(top))
+            got.push_back(c);
+        IT_ASSERT(got == post);
+        got.clear();
+        for (auto c : wythe::leaves(top))
+            got.push_back(c);
+        IT_ASSERT(got == leaf);
+        got.clear();
+        for (auto [c, depth] : wythe::with_depth(top)) {
+            got.push_back(c);
+            depths.push_back(depth);
+        }
+        IT_ASSERT(got == pre && depths == levels);
+    }
+
+    // no descendants
+    wythe::multivector<int> empty;
+    IT_ASSERT(std::ranges::distance(wythe::preorder(empty.root())) == 0);
+    IT_ASSERT(std::ranges::distance(wythe::postorder(*wythe::leaves(a.root()).begin())) == 0);
+    IT_ASSERT(std::ranges::distance(wythe::leaves(empty.root())) == 0);
+    IT_ASSERT(std::ranges::distance(wythe::with_depth(empty.root())) == 0);
+
+    // pause and continue where it left off
+    const auto &b = a;
+    auto g = wythe::preorder(b.root());
+    std::vector<int> values;
+    for (auto c : g) {
+        values.push_back(*c);
+        if (values.size() == 3)
+            break;
+    }
+    // still at the item the loop stopped on
+    auto i = g.begin();
+    IT_ASSERT(**i == values.back());
+    for (++i; i != g.end(); ++i)
+        values.push_back(**i);
+    std::vector<int> expected;
+    wythe::recurse(b.root(), [&](wythe::multivector<int>::const_cursor c) { expected.push_back(*c); });
+    IT_ASSERT(values == expected);
+
+    // cooperative cancellation
+    std::stop_source stop;
+    size_t n = 0;
+    for (auto c : wythe::postorder(a.root(), stop.get_token())) {
+        (void)c;
+        if (++n == 5)
+            stop.request_stop();
+    }
+    IT_ASSERT(n == 5);
+    IT_ASSERT(std::ranges::distance(wythe::with_depth(a.root(), stop.get_token())) == 0);
+
+    // depth needs no stack
+    wythe::multivector<int> deep;
+    auto c = deep.root();
+    for (int k = 0; k < 10000; ++k)
+        c = c.emplace(k);
+    IT_ASSERT(std::ranges::distance(wythe::leaves(deep.root())) == 1);
+    int d = -1;
+    for (auto [c, depth] : wythe::with_depth(deep.root()))
+        d = depth;
+    IT_ASSERT(d == 9999);
+}
+
+void multivector_unit::grafting() {
+    auto a = create_complicated();
+    auto expected = a;
+    auto f = create_complicated();
+    auto p = (a.begin() + 1).begin();
+    wythe::append(wythe::navigate(expected.root(), 1, 0), f.root());
+    auto top = f.root().size();
+    auto values = &f.begin().item_ref().nodes_.front().value;
+    wythe::graft(p, std::move(f));
+    IT_ASSERT(f.empty());
+    IT_ASSERT(a == expected);
+    wythe::verify(a);
+    IT_ASSERT(linked(a.root()));
+    // the subvectors moved, not the values
+    IT_ASSERT(&(p.end() - top).item_ref().nodes_.front().value == values);
+
+    // into the root and into an empty tree
+    wythe::multivector<int> b;
+    wythe::graft(b.root(), create_complicated());
+    IT_ASSERT(b == create_complicated());
+    wythe::graft(b.root(), wythe::multivector<int>());
+    IT_ASSERT(b == create_complicated());
+    wythe::verify(b);
+
+    // observers see every value
+    wythe::value_index<int> index(b);
+    wythe::graft(b.begin(), create_complicated());
+    IT_ASSERT(index.count(3) == 8);
+    IT_ASSERT(indexes(index, b));
+    wythe::verify(b);
+}
+
+void multivector_unit::parallel_building() {
+    // fragment k is a chain of k leaves under k, under parents of each depth
+    auto fragment = [](int k) {
+        return [k](wythe::multivector<int> &f) {
+            auto c = f.root().emplace(k);
+            for (int i = 0; i < k; ++i)
+                c.emplace_back(i);
+        };
+    };
+    auto build = [&](unsigned threads) {
+        wythe::multivector<int> a;
+        a.emplace_back(-1);
+        a.emplace_back(-2);
+        a.begin().emplace_back(-3);
+        wythe::parallel_builder<int> builder(a);
+        for (int k = 0; k < 200; ++k) {
+            auto parents = {a.root(), a.begin(), a.begin() + 1};
+            builder.add(*(parents.begin() + k % 3), fragment(k));
+            if (k == 100)
+                builder.add(a.begin().begin(), fragment(7)); // below the parent of others
+        }
+        IT_ASSERT(builder.size() == 201);
+        builder.run(threads);
+        IT_ASSERT(builder.size() == 0);
+        return a;
+    };
+
+    wythe::multivector<int> expected;
+    expected.emplace_back(-1);
+    expected.emplace_back(-2);
+    expected.begin().emplace_back(-3);
+    for (int k = 0; k < 200; ++k) {
+        wythe::multivector<int> f;
+        fragment(k)(f);
+        auto parents = {expected.root(), expected.begin(), expected.begin() + 1};
+        wythe::append(*(parents.begin() + k % 3), f.root());
+        if (k == 100) {
+            wythe::multivector<int> g;
+            fragment(7)(g);
+            wythe::append(expected.begin().begin(), g.root());
+        }
+    }
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        auto a = build(threads);
+        IT_ASSERT(a == expected);
+        wythe::verify(a);
+        IT_ASSERT(linked(a.root()));
+    }
+
+    // a failing job stops the run after the fragments before it
+    wythe::multivector<int> a;
+    wythe::parallel_builder<int> builder(a);
+    for (int k = 0; k < 50; ++k)
+        if (k == 20)
+            builder.add(a.root(), [](wythe::multivector<int> &) { throw std::runtime_error("bad"); });
+        else
+            builder.add(a.root(), fragment(k));
+    bool thrown = false;
+    try { builder.run(4); }
+    catch (std::runtime_error &) { thrown = true; }
+    IT_ASSERT(thrown && a.root().size() == 20 && builder.size() == 0);
+
+    // so does a parent that no longer exists, with the workers still building
+    wythe::multivector<int> b;
+    b.root().emplace(-1).emplace_back(-2);
+    wythe::parallel_builder<int> orphans(b);
+    for (int k = 0; k < 50; ++k)
+        orphans.add(k == 10 ? b.begin().begin() : b.root(), fragment(k));
+    b.root().pop_back();
+    thrown = false;
+    try { orphans.run(4); }
+    catch (std::out_of_range &) { thrown = true; }
+    IT_ASSERT(thrown && b.root().size() == 10 && orphans.size() == 0);
+    wythe::verify(a);
+}
 
 int main (int, char **) {
     multivector_unit test;
@@ -22,6 +22,32 @@ class multivector_unit
         ut.add(&multivector_unit::precursor);
         ut.add(&multivector_unit::precursor2);
         ut.add(&multivector_unit::append_children);
+        ut.add(&multivector_unit::in_place);
+        ut.add(&multivector_unit::move_only);
+        ut.add(&multivector_unit::interned);
+        ut.add(&multivector_unit::compacting);
+        ut.add(&multivector_unit::binary);
+        ut.add(&multivector_unit::view);
+        ut.add(&multivector_unit::parsing);
+        ut.add(&multivector_unit::writers);
+        ut.add(&multivector_unit::streaming);
+        ut.add(&multivector_unit::json);
+        ut.add(&multivector_unit::journal);
+        ut.add(&multivector_unit::lazy);
+        ut.add(&multivector_unit::parallel_binary);
+        ut.add(&multivector_unit::paths);
+        ut.add(&multivector_unit::value_indexing);
+        ut.add(&multivector_unit::labels);
+        ut.add(&multivector_unit::roots);
+        ut.add(&multivector_unit::selectors);
+        ut.add(&multivector_unit::sorted_children);
+        ut.add(&multivector_unit::subtree_aggregates);
+        ut.add(&multivector_unit::snapshots);
+        ut.add(&multivector_unit::partitions);
+        ut.add(&multivector_unit::concurrent_appends);
+        ut.add(&multivector_unit::traversals);
+        ut.add(&multivector_unit::grafting);
+        ut.add(&multivector_unit::parallel_building);
     }
 
     void empty_multivectors();
@@ -39,4 +65,30 @@ class multivector_unit
     void precursor();
     void precursor2();
     void append_children();
+    void in_place();
+    void move_only();
+    void interned();
+    void compacting();
+    void binary();
+    void view();
+    void parsing();
+    void writers();
+    void streaming();
+    void json();
+    void journal();
+    void lazy();
+    void parallel_binary();
+    void paths();
+    void value_indexing();
+    void labels();
+    void roots();
+    void selectors();
+    void sorted_children();
+    void subtree_aggregates();
+    void snapshots();
+    void partitions();
+    void concurrent_appends();
+    void traversals();
+    void grafting();
+    void parallel_building();
 };